@@ -0,0 +1,53 @@
+#include "bloom_filter.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+BloomFilter::BloomFilter(size_t capacity)
+        : blocks_(max<size_t>(1, (capacity * BITS_PER_STRING + BLOCK_BITS - 1) / BLOCK_BITS))
+        , capacity_(capacity)
+{
+}
+
+void BloomFilter::Add(string_view text) {
+    auto [block_index, bits_hash] = Locate(text);
+    Block& block = blocks_[block_index];
+    for (int i = 0; i < HASH_COUNT; ++i, bits_hash >>= 9) {
+        const size_t bit = bits_hash % BLOCK_BITS;
+        block.words[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+    ++size_;
+}
+
+bool BloomFilter::MayContain(string_view text) const {
+    auto [block_index, bits_hash] = Locate(text);
+    const Block& block = blocks_[block_index];
+    for (int i = 0; i < HASH_COUNT; ++i, bits_hash >>= 9) {
+        const size_t bit = bits_hash % BLOCK_BITS;
+        if (!(block.words[bit / 64] & (uint64_t(1) << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t BloomFilter::size() const {
+    return size_;
+}
+
+size_t BloomFilter::GetCapacity() const {
+    return capacity_;
+}
+
+size_t BloomFilter::ByteSize() const {
+    return blocks_.capacity() * sizeof(Block);
+}
+
+pair<size_t, uint64_t> BloomFilter::Locate(string_view text) const {
+    const uint64_t hash = std::hash<string_view>()(text);
+    // The bits of a block come from a remixed hash, so they do not correlate with the block index
+    const uint64_t bits_hash = (hash ^ (hash >> 29)) * 0x9E3779B97F4A7C15ull;
+    return { hash % blocks_.size(), bits_hash };
+}
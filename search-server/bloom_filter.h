@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Blocked Bloom filter over strings: all bits of a string fall into one cache line, so a lookup
+// touches one line. About 1% of absent strings are reported as possibly present while the filter
+// holds no more strings than its capacity.
+class BloomFilter {
+public:
+    explicit BloomFilter(size_t capacity = 0);
+
+    void Add(std::string_view text);
+
+    // False means the string was never added
+    bool MayContain(std::string_view text) const;
+
+    // Strings added
+    size_t size() const;
+
+    size_t GetCapacity() const;
+
+    size_t ByteSize() const;
+
+private:
+    static const size_t BITS_PER_STRING = 10;
+    static const int HASH_COUNT = 7;
+    static const size_t BLOCK_BITS = 512;
+
+    struct alignas(64) Block {
+        uint64_t words[BLOCK_BITS / 64] = {};
+    };
+
+    std::vector<Block> blocks_;
+    size_t capacity_;
+    size_t size_ = 0;
+
+    // Block of the string and the hash its bits in the block are taken from
+    std::pair<size_t, uint64_t> Locate(std::string_view text) const;
+};
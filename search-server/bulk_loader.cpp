@@ -0,0 +1,388 @@
+#include "bulk_loader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <execution>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw runtime_error("Cannot open "s + path + ": "s + strerror(errno));
+        }
+        struct stat file_stat{};
+        fstat(fd, &file_stat);
+        size_ = static_cast<size_t>(file_stat.st_size);
+        if (size_ > 0) {
+            data_ = static_cast<char*>(mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0));
+        }
+        close(fd);
+        if (data_ == MAP_FAILED) {
+            throw runtime_error("Cannot map "s + path + ": "s + strerror(errno));
+        }
+        if (size_ > 0) {
+            madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (size_ > 0) {
+            munmap(data_, size_);
+        }
+    }
+
+    string_view GetContents() const {
+        return { data_, size_ };
+    }
+
+    // Drops the pages wholly inside [begin, end) from memory, they are read again only if touched
+    void Release(size_t begin, size_t end) const {
+        const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        begin = (begin + page_size - 1) / page_size * page_size;
+        end = end / page_size * page_size;
+        if (begin < end) {
+            madvise(data_ + begin, end - begin, MADV_DONTNEED);
+        }
+    }
+
+private:
+    char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+int ParseInt(string_view text) {
+    while (!text.empty() && text.front() == ' ') {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && text.back() == ' ') {
+        text.remove_suffix(1);
+    }
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc() || end != text.data() + text.size()) {
+        throw invalid_argument("Invalid number "s + string(text));
+    }
+    return value;
+}
+
+vector<int> ParseRatings(string_view text) {
+    vector<int> ratings;
+    while (!text.empty()) {
+        const size_t comma = min(text.find(','), text.size());
+        ratings.push_back(ParseInt(text.substr(0, comma)));
+        text.remove_prefix(min(comma + 1, text.size()));
+    }
+    return ratings;
+}
+
+// Minimal reader of the flat JSON objects of a JSONL corpus
+class JsonCursor {
+public:
+    explicit JsonCursor(string_view text)
+            : text_(text) {
+    }
+
+    void Expect(char c) {
+        SkipSpaces();
+        if (text_.empty() || text_.front() != c) {
+            throw invalid_argument("Expected '"s + c + "' in JSON record"s);
+        }
+        text_.remove_prefix(1);
+    }
+
+    bool Consume(char c) {
+        SkipSpaces();
+        if (!text_.empty() && text_.front() == c) {
+            text_.remove_prefix(1);
+            return true;
+        }
+        return false;
+    }
+
+    // Returns a view of the raw string and whether it contains escapes
+    pair<string_view, bool> ReadRawString() {
+        Expect('"');
+        bool has_escapes = false;
+        size_t end = 0;
+        while (end < text_.size() && text_[end] != '"') {
+            if (text_[end] == '\\') {
+                has_escapes = true;
+                ++end;
+            }
+            ++end;
+        }
+        if (end >= text_.size()) {
+            throw invalid_argument("Unterminated JSON string"s);
+        }
+        const string_view raw = text_.substr(0, end);
+        text_.remove_prefix(end + 1);
+        return { raw, has_escapes };
+    }
+
+    string_view ReadNumber() {
+        SkipSpaces();
+        const size_t end = min(text_.find_first_not_of("-+0123456789"sv), text_.size());
+        const string_view number = text_.substr(0, end);
+        text_.remove_prefix(end);
+        return number;
+    }
+
+private:
+    string_view text_;
+
+    void SkipSpaces() {
+        while (!text_.empty() && (text_.front() == ' ' || text_.front() == '\t')) {
+            text_.remove_prefix(1);
+        }
+    }
+};
+
+// Code unit of a \uXXXX escape starting at the u
+uint32_t ParseUnicodeEscape(string_view raw, size_t position) {
+    uint32_t code_unit = 0;
+    const auto [end, error] = from_chars(raw.data() + position + 1, raw.data() + min(position + 5, raw.size()), code_unit, 16);
+    if (error != errc() || end != raw.data() + position + 5) {
+        throw invalid_argument("Invalid JSON escape \\"s + string(raw.substr(position, 5)));
+    }
+    return code_unit;
+}
+
+void AppendUtf8(string& out, uint32_t code_point) {
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    }
+    else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000) {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+// Throws std::invalid_argument for a \u escape without four hex digits
+string Unescape(string_view raw) {
+    const uint32_t REPLACEMENT_CHARACTER = 0xFFFD;
+    string result;
+    result.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] != '\\' || i + 1 == raw.size()) {
+            result += raw[i];
+            continue;
+        }
+        switch (raw[++i]) {
+            case 'n':
+            case 't':
+            case 'r':
+            case 'b':
+            case 'f':
+                // Documents are split on spaces only, so whitespace and control escapes become spaces
+                result += ' ';
+                break;
+            case 'u': {
+                uint32_t code_point = ParseUnicodeEscape(raw, i);
+                i += 4;
+                if (code_point >= 0xD800 && code_point < 0xDC00) {
+                    // A high surrogate combines with the low surrogate escaped right after it
+                    const bool has_low = i + 2 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u';
+                    const uint32_t low = has_low ? ParseUnicodeEscape(raw, i + 2) : 0;
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                    else {
+                        code_point = REPLACEMENT_CHARACTER;
+                    }
+                }
+                else if (code_point >= 0xDC00 && code_point < 0xE000) {
+                    code_point = REPLACEMENT_CHARACTER;
+                }
+                if (code_point < 0x20) {
+                    result += ' ';
+                }
+                else {
+                    AppendUtf8(result, code_point);
+                }
+                break;
+            }
+            default:
+                result += raw[i];
+        }
+    }
+    return result;
+}
+
+}
+
+CorpusRecord ParseTsvRecord(string_view line) {
+    string_view fields[4];
+    for (int i = 0; i < 3; ++i) {
+        const size_t tab = line.find('\t');
+        if (tab == string_view::npos) {
+            throw invalid_argument("TSV record must have 4 fields"s);
+        }
+        fields[i] = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+    }
+    fields[3] = line;
+
+    CorpusRecord record;
+    record.id = ParseInt(fields[0]);
+    record.status = ParseDocumentStatus(fields[1]);
+    record.ratings = ParseRatings(fields[2]);
+    record.text = fields[3];
+    return record;
+}
+
+CorpusRecord ParseJsonRecord(string_view line) {
+    CorpusRecord record;
+    bool has_id = false;
+    bool has_text = false;
+    JsonCursor cursor(line);
+    cursor.Expect('{');
+    if (!cursor.Consume('}')) {
+        do {
+            const string_view key = cursor.ReadRawString().first;
+            cursor.Expect(':');
+            if (key == "id"sv) {
+                record.id = ParseInt(cursor.ReadNumber());
+                has_id = true;
+            }
+            else if (key == "status"sv) {
+                record.status = ParseDocumentStatus(cursor.ReadRawString().first);
+            }
+            else if (key == "ratings"sv) {
+                cursor.Expect('[');
+                if (!cursor.Consume(']')) {
+                    do {
+                        record.ratings.push_back(ParseInt(cursor.ReadNumber()));
+                    } while (cursor.Consume(','));
+                    cursor.Expect(']');
+                }
+            }
+            else if (key == "text"sv) {
+                const auto [raw, has_escapes] = cursor.ReadRawString();
+                if (has_escapes) {
+                    record.unescaped_text = Unescape(raw);
+                }
+                else {
+                    record.text = raw;
+                }
+                has_text = true;
+            }
+            else {
+                throw invalid_argument("Unknown JSON field "s + string(key));
+            }
+        } while (cursor.Consume(','));
+        cursor.Expect('}');
+    }
+    if (!has_id || !has_text) {
+        throw invalid_argument("JSON record must have id and text"s);
+    }
+    return record;
+}
+
+void ForEachRecordBatch(const string& path, const BulkLoadOptions& options,
+                        const function<void(const vector<CorpusRecord>&)>& consumer) {
+    const MappedFile file(path);
+    const string_view contents = file.GetContents();
+    auto parse_record = options.format == CorpusFormat::TSV ? ParseTsvRecord : ParseJsonRecord;
+
+    struct Chunk {
+        size_t begin;
+        size_t end;
+        vector<CorpusRecord> records;
+        size_t error_line = 0;
+        string error;
+    };
+    vector<Chunk> chunks(max<size_t>(options.chunks_in_flight, 1));
+    size_t lines_before_batch = 0;
+
+    for (size_t offset = 0; offset < contents.size();) {
+        // Cut the next chunks at line breaks
+        size_t chunk_count = 0;
+        for (; chunk_count < chunks.size() && offset < contents.size(); ++chunk_count) {
+            const size_t nominal_end = min(offset + max<size_t>(options.chunk_size, 1), contents.size());
+            const size_t line_end = contents.find('\n', nominal_end - 1);
+            const size_t end = line_end == string_view::npos ? contents.size() : line_end + 1;
+            chunks[chunk_count].begin = offset;
+            chunks[chunk_count].end = end;
+            offset = end;
+        }
+
+        // Exceptions must not escape a parallel algorithm, so every chunk keeps its first error
+        for_each(execution::par, chunks.begin(), chunks.begin() + chunk_count, [&](Chunk& chunk) {
+            chunk.records.clear();
+            chunk.error_line = 0;
+            string_view text = contents.substr(chunk.begin, chunk.end - chunk.begin);
+            size_t line_number = 0;
+            while (!text.empty()) {
+                const size_t line_end = min(text.find('\n'), text.size());
+                string_view line = text.substr(0, line_end);
+                text.remove_prefix(min(line_end + 1, text.size()));
+                ++line_number;
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+                if (line.empty()) {
+                    continue;
+                }
+                try {
+                    chunk.records.push_back(parse_record(line));
+                }
+                catch (const exception& e) {
+                    chunk.error_line = line_number;
+                    chunk.error = e.what();
+                    return;
+                }
+            }
+            // Views into unescaped texts are taken only once the records stop moving
+            for (CorpusRecord& record : chunk.records) {
+                if (!record.unescaped_text.empty()) {
+                    record.text = record.unescaped_text;
+                }
+            }
+        });
+
+        for (size_t i = 0; i < chunk_count; ++i) {
+            Chunk& chunk = chunks[i];
+            if (chunk.error_line != 0) {
+                // Chunks start at line breaks, so the lines before the chunk give its first line number
+                const size_t lines_before_chunk = lines_before_batch
+                        + count(contents.begin() + chunks[0].begin, contents.begin() + chunk.begin, '\n');
+                throw invalid_argument("Corpus "s + path + ", line "s + to_string(lines_before_chunk + chunk.error_line)
+                                       + ": "s + chunk.error);
+            }
+            consumer(chunk.records);
+            file.Release(chunk.begin, chunk.end);
+        }
+        lines_before_batch += count(contents.begin() + chunks[0].begin,
+                                    contents.begin() + chunks[chunk_count - 1].end, '\n');
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+enum class CorpusFormat {
+    // id <tab> status <tab> comma-separated ratings <tab> text
+    TSV,
+    // {"id": 1, "status": "ACTUAL", "ratings": [1, 2], "text": "..."}
+    JSONL,
+};
+
+// One document of a corpus file. The text views the mapped file unless it had to be unescaped.
+struct CorpusRecord {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+    std::string unescaped_text;
+};
+
+struct BulkLoadOptions {
+    CorpusFormat format = CorpusFormat::TSV;
+    // Chunks are cut at the first line break after this many bytes and parsed in parallel
+    size_t chunk_size = 16 << 20;
+    // Chunks parsed and kept in memory at once, this bounds the memory the loader needs
+    size_t chunks_in_flight = 8;
+};
+
+CorpusRecord ParseTsvRecord(std::string_view line);
+
+CorpusRecord ParseJsonRecord(std::string_view line);
+
+// Memory-maps the file and hands its records to consumer in batches, in file order.
+// Pages of the file are released once their batch has been consumed.
+// Throws std::invalid_argument naming the line of a malformed record.
+void ForEachRecordBatch(const std::string& path, const BulkLoadOptions& options,
+                        const std::function<void(const std::vector<CorpusRecord>&)>& consumer);
+
+// Adds every document of the corpus file to the index, returns the number of documents added
+template <typename Index>
+size_t LoadCorpus(Index& index, const std::string& path, const BulkLoadOptions& options = {}) {
+    size_t document_count = 0;
+    ForEachRecordBatch(path, options, [&index, &document_count](const std::vector<CorpusRecord>& records) {
+        for (const CorpusRecord& record : records) {
+            index.AddDocument(record.id, record.text, record.status, record.ratings);
+        }
+        document_count += records.size();
+    });
+    return document_count;
+}
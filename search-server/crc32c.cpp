@@ -0,0 +1,53 @@
+#include "crc32c.h"
+
+#include <array>
+
+using namespace std;
+
+namespace {
+
+// Reflected polynomial of CRC-32C
+const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+// Slicing by 8: tables[k][b] is the CRC of byte b followed by k zero bytes
+array<array<uint32_t, 256>, 8> MakeTables() {
+    array<array<uint32_t, 256>, 8> tables{};
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+        }
+        tables[0][byte] = crc;
+    }
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        for (size_t k = 1; k < 8; ++k) {
+            tables[k][byte] = (tables[k - 1][byte] >> 8) ^ tables[0][tables[k - 1][byte] & 0xFF];
+        }
+    }
+    return tables;
+}
+
+const array<array<uint32_t, 256>, 8> CRC32C_TABLES = MakeTables();
+
+}
+
+uint32_t ExtendCrc32c(uint32_t crc, string_view data) {
+    const auto* current = reinterpret_cast<const uint8_t*>(data.data());
+    const auto* end = current + data.size();
+    crc = ~crc;
+    for (; end - current >= 8; current += 8) {
+        const uint32_t low = crc ^ (current[0] | current[1] << 8 | current[2] << 16 | static_cast<uint32_t>(current[3]) << 24);
+        crc = CRC32C_TABLES[7][low & 0xFF] ^ CRC32C_TABLES[6][(low >> 8) & 0xFF]
+              ^ CRC32C_TABLES[5][(low >> 16) & 0xFF] ^ CRC32C_TABLES[4][low >> 24]
+              ^ CRC32C_TABLES[3][current[4]] ^ CRC32C_TABLES[2][current[5]]
+              ^ CRC32C_TABLES[1][current[6]] ^ CRC32C_TABLES[0][current[7]];
+    }
+    for (; current != end; ++current) {
+        crc = (crc >> 8) ^ CRC32C_TABLES[0][(crc ^ *current) & 0xFF];
+    }
+    return ~crc;
+}
+
+uint32_t ComputeCrc32c(string_view data) {
+    return ExtendCrc32c(0, data);
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// CRC-32C (Castagnoli) of data, detects torn and corrupted records of files written by this process
+uint32_t ComputeCrc32c(std::string_view data);
+
+// CRC-32C of the bytes the crc was computed over followed by data
+uint32_t ExtendCrc32c(uint32_t crc, std::string_view data);
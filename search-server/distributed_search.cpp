@@ -0,0 +1,367 @@
+#include "distributed_search.h"
+#include "sharded_search_server.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+sockaddr_un MakeUnixAddress(const string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Socket path "s + path + " is too long"s);
+    }
+    strcpy(address.sun_path, path.c_str());
+    return address;
+}
+
+int ListenUnixSocket(const string& path) {
+    const sockaddr_un address = MakeUnixAddress(path);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw runtime_error("socket: "s + strerror(errno));
+    }
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 16) < 0) {
+        const string error = strerror(errno);
+        close(fd);
+        throw runtime_error("Cannot listen on "s + path + ": "s + error);
+    }
+    return fd;
+}
+
+// Retries until the deadline, so a freshly spawned shard has time to start listening
+int ConnectUnixSocket(const string& path, chrono::steady_clock::time_point deadline) {
+    const sockaddr_un address = MakeUnixAddress(path);
+    while (true) {
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            throw runtime_error("socket: "s + strerror(errno));
+        }
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+            return fd;
+        }
+        close(fd);
+        if (chrono::steady_clock::now() >= deadline) {
+            throw runtime_error("Cannot connect to shard "s + path);
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+}
+
+Message MakeError(uint64_t request_id, const string& what) {
+    PayloadWriter writer;
+    writer.WriteString(what);
+    return { MessageType::ERROR, request_id, writer.Release() };
+}
+
+// Statuses index arrays of the index, so a byte naming none of them is rejected
+DocumentStatus ReadStatus(PayloadReader& reader) {
+    const uint8_t status = reader.ReadByte();
+    if (status >= DOCUMENT_STATUS_COUNT) {
+        throw invalid_argument("Invalid document status "s + to_string(status));
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+}
+
+ShardProcess::ShardProcess(string socket_path, string_view stop_words_text, const IndexOptions& options)
+        : server_(stop_words_text, options)
+        , socket_path_(move(socket_path))
+        , listen_fd_(ListenUnixSocket(socket_path_))
+{
+}
+
+ShardProcess::~ShardProcess() {
+    close(listen_fd_);
+    unlink(socket_path_.c_str());
+}
+
+void ShardProcess::Serve() {
+    vector<MessageStream> connections;
+    while (true) {
+        vector<pollfd> descriptors{ { listen_fd_, POLLIN, 0 } };
+        for (const MessageStream& connection : connections) {
+            descriptors.push_back({ connection.GetFd(), POLLIN, 0 });
+        }
+        if (poll(descriptors.data(), descriptors.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("poll: "s + strerror(errno));
+        }
+
+        if (descriptors[0].revents & POLLIN) {
+            if (const int fd = accept(listen_fd_, nullptr, nullptr); fd >= 0) {
+                connections.emplace_back(fd);
+            }
+        }
+        for (size_t i = 1; i < descriptors.size(); ++i) {
+            if (descriptors[i].revents == 0) {
+                continue;
+            }
+            MessageStream& connection = connections[i - 1];
+            bool is_open = connection.ReadAvailable();
+            try {
+                while (auto request = connection.PopMessage()) {
+                    if (request->type == MessageType::SHUTDOWN) {
+                        SendMessage(connection.GetFd(), { MessageType::ACK, request->request_id, {} });
+                        for (const MessageStream& other : connections) {
+                            close(other.GetFd());
+                        }
+                        return;
+                    }
+                    SendMessage(connection.GetFd(), Handle(*request));
+                }
+            }
+            catch (const runtime_error&) {
+                // A bad frame leaves the rest of the stream unreadable, so only this connection is closed
+                is_open = false;
+            }
+            if (!is_open) {
+                close(connection.GetFd());
+                connection = MessageStream(-1);
+            }
+        }
+        connections.erase(remove_if(connections.begin(), connections.end(), [](const MessageStream& connection) {
+            return connection.GetFd() < 0;
+        }), connections.end());
+    }
+}
+
+Message ShardProcess::Handle(const Message& request) {
+    try {
+        PayloadReader reader(request.payload);
+        PayloadWriter writer;
+        switch (request.type) {
+            case MessageType::ADD_DOCUMENT: {
+                const int document_id = static_cast<int>(reader.ReadVarint());
+                const DocumentStatus status = ReadStatus(reader);
+                vector<int> ratings;
+                for (size_t rating_count = reader.ReadVarint(); rating_count > 0; --rating_count) {
+                    ratings.push_back(static_cast<int>(reader.ReadSignedVarint()));
+                }
+                server_.AddDocument(document_id, reader.ReadString(), status, ratings);
+                return { MessageType::ACK, request.request_id, {} };
+            }
+            case MessageType::REMOVE_DOCUMENT:
+                server_.RemoveDocument(static_cast<int>(reader.ReadVarint()));
+                return { MessageType::ACK, request.request_id, {} };
+            case MessageType::QUERY_STATISTICS:
+                WriteStatistics(writer, server_.GetQueryStatistics(reader.ReadString()));
+                return { MessageType::STATISTICS, request.request_id, writer.Release() };
+            case MessageType::SEARCH: {
+                const DocumentStatus status = ReadStatus(reader);
+                const string_view raw_query = reader.ReadString();
+                const CollectionStatistics collection = ReadStatistics(reader);
+                const auto documents = server_.FindTopDocuments(raw_query, [status](int, DocumentStatus document_status, int) {
+                    return document_status == status;
+                }, collection);
+                WriteDocuments(writer, documents);
+                return { MessageType::RESULTS, request.request_id, writer.Release() };
+            }
+            default:
+                return MakeError(request.request_id, "Unknown request type"s);
+        }
+    }
+    catch (const exception& e) {
+        return MakeError(request.request_id, e.what());
+    }
+}
+
+pid_t SpawnShardProcess(const string& socket_path, string_view stop_words_text, const IndexOptions& options) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+        throw runtime_error("fork: "s + strerror(errno));
+    }
+    if (pid == 0) {
+        int exit_code = 0;
+        try {
+            ShardProcess shard(socket_path, stop_words_text, options);
+            shard.Serve();
+        }
+        catch (const exception& e) {
+            cerr << "Shard "s << socket_path << ": "s << e.what() << endl;
+            exit_code = 1;
+        }
+        _exit(exit_code);
+    }
+    return pid;
+}
+
+SearchBroker::SearchBroker(const vector<string>& shard_socket_paths, chrono::milliseconds timeout)
+        : timeout_(timeout)
+{
+    if (shard_socket_paths.empty()) {
+        throw invalid_argument("Broker needs at least one shard"s);
+    }
+    const auto deadline = chrono::steady_clock::now() + max(timeout, chrono::milliseconds(5000));
+    for (const string& path : shard_socket_paths) {
+        shards_.emplace_back(ConnectUnixSocket(path, deadline));
+    }
+}
+
+SearchBroker::~SearchBroker() {
+    for (const MessageStream& shard : shards_) {
+        close(shard.GetFd());
+    }
+}
+
+void SearchBroker::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    if (document_id < 0) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    PayloadWriter writer;
+    writer.WriteVarint(document_id);
+    writer.WriteByte(static_cast<uint8_t>(status));
+    writer.WriteVarint(ratings.size());
+    for (const int rating : ratings) {
+        writer.WriteSignedVarint(rating);
+    }
+    writer.WriteString(document);
+    Exchange(GetShardIndex(document_id, shards_.size()), MessageType::ADD_DOCUMENT, writer.Release());
+}
+
+void SearchBroker::RemoveDocument(int document_id) {
+    if (document_id < 0) {
+        return;
+    }
+    PayloadWriter writer;
+    writer.WriteVarint(document_id);
+    Exchange(GetShardIndex(document_id, shards_.size()), MessageType::REMOVE_DOCUMENT, writer.Release());
+}
+
+DistributedSearchResult SearchBroker::FindTopDocuments(string_view raw_query, DocumentStatus status) {
+    auto check_error = [](const optional<Message>& reply) {
+        if (reply && reply->type == MessageType::ERROR) {
+            PayloadReader reader(reply->payload);
+            throw invalid_argument(string(reader.ReadString()));
+        }
+    };
+
+    PayloadWriter statistics_request;
+    statistics_request.WriteString(raw_query);
+    vector<CollectionStatistics> shard_statistics;
+    vector<bool> has_statistics(shards_.size());
+    const auto statistics_replies = Broadcast(MessageType::QUERY_STATISTICS, statistics_request.Release());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        check_error(statistics_replies[i]);
+        if (statistics_replies[i]) {
+            PayloadReader reader(statistics_replies[i]->payload);
+            shard_statistics.push_back(ReadStatistics(reader));
+            has_statistics[i] = true;
+        }
+    }
+
+    PayloadWriter search_request;
+    search_request.WriteByte(static_cast<uint8_t>(status));
+    search_request.WriteString(raw_query);
+    WriteStatistics(search_request, MergeStatistics(shard_statistics));
+
+    DistributedSearchResult result;
+    const auto search_replies = Broadcast(MessageType::SEARCH, search_request.Release(), has_statistics);
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        const auto& reply = search_replies[i];
+        check_error(reply);
+        if (!reply) {
+            result.missing_shards.push_back(i);
+            continue;
+        }
+        PayloadReader reader(reply->payload);
+        for (Document& document : ReadDocuments(reader)) {
+            result.documents.push_back(move(document));
+        }
+    }
+    sort(result.documents.begin(), result.documents.end(), SearchServer::IsRankedBefore);
+    if (result.documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        result.documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return result;
+}
+
+void SearchBroker::Shutdown() {
+    Broadcast(MessageType::SHUTDOWN, {});
+}
+
+vector<optional<Message>> SearchBroker::Broadcast(MessageType type, const string& payload, const vector<bool>& shard_mask) {
+    const uint64_t request_id = next_request_id_++;
+    vector<optional<Message>> replies(shards_.size());
+    vector<bool> is_waiting(shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (!shard_mask.empty() && !shard_mask[i]) {
+            continue;
+        }
+        is_waiting[i] = SendMessage(shards_[i].GetFd(), { type, request_id, payload });
+    }
+
+    const auto deadline = chrono::steady_clock::now() + timeout_;
+    while (any_of(is_waiting.begin(), is_waiting.end(), [](bool waiting) { return waiting; })) {
+        const auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            break;
+        }
+        vector<pollfd> descriptors;
+        vector<size_t> shard_indexes;
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            if (is_waiting[i]) {
+                descriptors.push_back({ shards_[i].GetFd(), POLLIN, 0 });
+                shard_indexes.push_back(i);
+            }
+        }
+        if (poll(descriptors.data(), descriptors.size(), static_cast<int>(remaining.count())) < 0 && errno != EINTR) {
+            throw runtime_error("poll: "s + strerror(errno));
+        }
+        for (size_t i = 0; i < descriptors.size(); ++i) {
+            if (descriptors[i].revents == 0) {
+                continue;
+            }
+            MessageStream& shard = shards_[shard_indexes[i]];
+            const bool is_open = shard.ReadAvailable();
+            // Replies to requests that timed out earlier are dropped here
+            while (auto reply = shard.PopMessage()) {
+                if (reply->request_id == request_id) {
+                    replies[shard_indexes[i]] = move(reply);
+                    is_waiting[shard_indexes[i]] = false;
+                }
+            }
+            if (!is_open) {
+                is_waiting[shard_indexes[i]] = false;
+            }
+        }
+    }
+    return replies;
+}
+
+Message SearchBroker::Exchange(size_t shard_index, MessageType type, const string& payload) {
+    MessageStream& shard = shards_[shard_index];
+    const uint64_t request_id = next_request_id_++;
+    if (!SendMessage(shard.GetFd(), { type, request_id, payload })) {
+        throw runtime_error("Shard connection is closed"s);
+    }
+    const auto deadline = chrono::steady_clock::now() + timeout_;
+    while (true) {
+        auto reply = shard.Receive(deadline);
+        if (!reply) {
+            throw runtime_error("Shard did not answer in time"s);
+        }
+        if (reply->request_id != request_id) {
+            continue;
+        }
+        if (reply->type == MessageType::ERROR) {
+            PayloadReader reader(reply->payload);
+            throw invalid_argument(string(reader.ReadString()));
+        }
+        return move(*reply);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "search_server.h"
+#include "search_protocol.h"
+#include "document.h"
+
+// One part of a distributed index, answering a broker over a Unix domain socket
+class ShardProcess {
+public:
+    ShardProcess(std::string socket_path, std::string_view stop_words_text, const IndexOptions& options = {});
+
+    ShardProcess(const ShardProcess&) = delete;
+
+    ShardProcess& operator=(const ShardProcess&) = delete;
+
+    ~ShardProcess();
+
+    // Serves requests of any number of connections until a SHUTDOWN message arrives
+    void Serve();
+
+private:
+    SearchServer server_;
+    std::string socket_path_;
+    int listen_fd_;
+
+    Message Handle(const Message& request);
+};
+
+// Forks a process running a ShardProcess on socket_path and returns its pid
+pid_t SpawnShardProcess(const std::string& socket_path, std::string_view stop_words_text, const IndexOptions& options = {});
+
+struct DistributedSearchResult {
+    std::vector<Document> documents;
+    // Indexes of the shards that did not answer either phase in time, their documents are missing from the results
+    std::vector<size_t> missing_shards;
+};
+
+// Fans queries out to shard processes: first gathers collection statistics so every shard ranks with the
+// global document frequencies, then merges the per-shard top documents. A shard missing the statistics is left
+// out of the search, as the frequencies would not count its documents.
+class SearchBroker {
+public:
+    SearchBroker(const std::vector<std::string>& shard_socket_paths, std::chrono::milliseconds timeout);
+
+    SearchBroker(const SearchBroker&) = delete;
+
+    SearchBroker& operator=(const SearchBroker&) = delete;
+
+    ~SearchBroker();
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    DistributedSearchResult FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+
+    // Stops every shard process
+    void Shutdown();
+
+private:
+    std::vector<MessageStream> shards_;
+    std::chrono::milliseconds timeout_;
+    uint64_t next_request_id_ = 1;
+
+    // Sends one request to the shards of the mask, every shard if it is empty, and collects the replies that
+    // arrive before the timeout
+    std::vector<std::optional<Message>> Broadcast(MessageType type, const std::string& payload, const std::vector<bool>& shard_mask = {});
+
+    Message Exchange(size_t shard_index, MessageType type, const std::string& payload);
+};
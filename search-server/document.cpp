@@ -1,5 +1,8 @@
 #include "document.h"
 
+#include <algorithm>
+#include <stdexcept>
+
 using namespace std;
 
 Document::Document() = default;
@@ -36,6 +39,24 @@ Document& Document::operator=(Document&& doc_to_copy) {
     rating = exchange(doc_to_copy.rating, 0);
     return *this;
 }
+namespace {
+
+const string_view STATUS_NAMES[] = { "ACTUAL"sv, "IRRELEVANT"sv, "BANNED"sv, "REMOVED"sv };
+
+}
+
+string_view GetStatusName(DocumentStatus status) {
+    return STATUS_NAMES[static_cast<int>(status)];
+}
+
+DocumentStatus ParseDocumentStatus(string_view name) {
+    const auto it = find(begin(STATUS_NAMES), end(STATUS_NAMES), name);
+    if (it == end(STATUS_NAMES)) {
+        throw invalid_argument("Invalid status "s + string(name));
+    }
+    return static_cast<DocumentStatus>(it - begin(STATUS_NAMES));
+}
+
 void PrintMatchDocumentResult(int document_id, const vector<string_view>& words, DocumentStatus status) {
     cout << "{ "s
          << "document_id = "s << document_id << ", "s
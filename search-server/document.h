@@ -1,8 +1,10 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <utility>
+#include <optional>
 
 struct Document {
     Document();
@@ -19,6 +21,31 @@ struct Document {
 
 std::ostream& operator<<(std::ostream& out, const Document& document);
 
+// Position of the last document of a page in the ranking order; pass it back to get the next page
+struct SearchCursor {
+    double relevance = 0.0;
+    int rating = 0;
+    int id = 0;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    std::optional<SearchCursor> next;
+};
+
+// Part of a document text around query words
+struct Snippet {
+    struct Highlight {
+        // Bytes of a query word within the snippet text
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    int document_id = 0;
+    std::string text;
+    std::vector<Highlight> highlights;
+};
+
 enum class DocumentStatus {
     ACTUAL,
     IRRELEVANT,
@@ -26,4 +53,13 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// Number of DocumentStatus values
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
+// Status names as they appear in text formats: ACTUAL, IRRELEVANT, BANNED, REMOVED
+std::string_view GetStatusName(DocumentStatus status);
+
+// Throws std::invalid_argument for an unknown name
+DocumentStatus ParseDocumentStatus(std::string_view name);
+
 void PrintMatchDocumentResult(int document_id, const std::vector<std::string_view>& words, DocumentStatus status);
\ No newline at end of file
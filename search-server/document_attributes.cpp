@@ -0,0 +1,166 @@
+#include "document_attributes.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+DocumentAttributes::Cursor::Cursor(const DocumentAttributes& attributes)
+        : blocks_(&attributes.blocks_)
+{
+}
+
+void DocumentAttributes::Cursor::Seek(int document_id) {
+    if ((*blocks_)[block_index_].ids.back() < document_id) {
+        block_index_ = partition_point(blocks_->begin() + block_index_ + 1, blocks_->end(), [document_id](const Block& block) {
+            return block.ids.back() < document_id;
+        }) - blocks_->begin();
+        offset_ = 0;
+    }
+    const vector<int>& ids = (*blocks_)[block_index_].ids;
+    // Postings of common terms step through neighbouring documents, those of rare ones jump
+    const size_t MAX_STEP_COUNT = 4;
+    for (size_t step = 0; step < MAX_STEP_COUNT && ids[offset_] < document_id; ++step) {
+        ++offset_;
+    }
+    if (ids[offset_] < document_id) {
+        offset_ = lower_bound(ids.begin() + offset_, ids.end(), document_id) - ids.begin();
+    }
+}
+
+int DocumentAttributes::Cursor::GetDocumentId() const {
+    return (*blocks_)[block_index_].ids[offset_];
+}
+
+DocumentStatus DocumentAttributes::Cursor::GetStatus() const {
+    return (*blocks_)[block_index_].statuses[offset_];
+}
+
+int DocumentAttributes::Cursor::GetRating() const {
+    return (*blocks_)[block_index_].ratings[offset_];
+}
+
+int DocumentAttributes::Cursor::GetLength() const {
+    return (*blocks_)[block_index_].lengths[offset_];
+}
+
+size_t DocumentAttributes::Cursor::GetSlot() const {
+    return block_index_ * BLOCK_CAPACITY + offset_;
+}
+
+void DocumentAttributes::Add(int document_id, DocumentStatus status, int rating, int length) {
+    size_t block_index = FindBlock(document_id);
+    if (block_index == blocks_.size()) {
+        if (blocks_.empty() || blocks_.back().ids.size() == BLOCK_CAPACITY) {
+            blocks_.emplace_back();
+        }
+        block_index = blocks_.size() - 1;
+    }
+    Block& block = blocks_[block_index];
+    const size_t offset = lower_bound(block.ids.begin(), block.ids.end(), document_id) - block.ids.begin();
+    block.ids.insert(block.ids.begin() + offset, document_id);
+    block.statuses.insert(block.statuses.begin() + offset, status);
+    block.ratings.insert(block.ratings.begin() + offset, rating);
+    block.lengths.insert(block.lengths.begin() + offset, length);
+    ++size_;
+
+    if (block.ids.size() > BLOCK_CAPACITY) {
+        Block upper;
+        const size_t middle = block.ids.size() / 2;
+        auto move_upper_half = [middle](auto& column, auto& upper_column) {
+            upper_column.assign(column.begin() + middle, column.end());
+            column.resize(middle);
+        };
+        move_upper_half(block.ids, upper.ids);
+        move_upper_half(block.statuses, upper.statuses);
+        move_upper_half(block.ratings, upper.ratings);
+        move_upper_half(block.lengths, upper.lengths);
+        blocks_.insert(blocks_.begin() + block_index + 1, move(upper));
+    }
+}
+
+void DocumentAttributes::Remove(int document_id) {
+    const size_t block_index = FindBlock(document_id);
+    if (block_index == blocks_.size()) {
+        return;
+    }
+    Block& block = blocks_[block_index];
+    const auto id_it = lower_bound(block.ids.begin(), block.ids.end(), document_id);
+    if (*id_it != document_id) {
+        return;
+    }
+    const size_t offset = id_it - block.ids.begin();
+    block.ids.erase(id_it);
+    block.statuses.erase(block.statuses.begin() + offset);
+    block.ratings.erase(block.ratings.begin() + offset);
+    block.lengths.erase(block.lengths.begin() + offset);
+    --size_;
+    if (block.ids.empty()) {
+        blocks_.erase(blocks_.begin() + block_index);
+    }
+}
+
+DocumentStatus DocumentAttributes::GetStatus(int document_id) const {
+    const auto [block, offset] = Find(document_id);
+    return block->statuses[offset];
+}
+
+int DocumentAttributes::GetRating(int document_id) const {
+    const auto [block, offset] = Find(document_id);
+    return block->ratings[offset];
+}
+
+int DocumentAttributes::GetLength(int document_id) const {
+    const auto [block, offset] = Find(document_id);
+    return block->lengths[offset];
+}
+
+size_t DocumentAttributes::size() const {
+    return size_;
+}
+
+const vector<DocumentAttributes::Block>& DocumentAttributes::GetBlocks() const {
+    return blocks_;
+}
+
+size_t DocumentAttributes::GetSlotCount() const {
+    return blocks_.size() * BLOCK_CAPACITY;
+}
+
+size_t DocumentAttributes::ByteSize() const {
+    size_t bytes = blocks_.capacity() * sizeof(Block);
+    for (const Block& block : blocks_) {
+        bytes += block.ids.capacity() * sizeof(int) + block.statuses.capacity() * sizeof(DocumentStatus)
+                 + block.ratings.capacity() * sizeof(int) + block.lengths.capacity() * sizeof(int);
+    }
+    return bytes;
+}
+
+size_t DocumentAttributes::FindBlock(int document_id) const {
+    return partition_point(blocks_.begin(), blocks_.end(), [document_id](const Block& block) {
+        return block.ids.back() < document_id;
+    }) - blocks_.begin();
+}
+
+pair<const DocumentAttributes::Block*, size_t> DocumentAttributes::Find(int document_id) const {
+    const size_t block_index = FindBlock(document_id);
+    if (block_index != blocks_.size()) {
+        const Block& block = blocks_[block_index];
+        const auto id_it = lower_bound(block.ids.begin(), block.ids.end(), document_id);
+        if (*id_it == document_id) {
+            return { &block, static_cast<size_t>(id_it - block.ids.begin()) };
+        }
+    }
+    throw out_of_range("Unknown document id "s + to_string(document_id));
+}
+
+void DocumentNormsCache::Invalidate() {
+    lock_guard guard(mutex_);
+    norms_.reset();
+}
+
+size_t DocumentNormsCache::ByteSize() const {
+    lock_guard guard(mutex_);
+    return norms_ != nullptr ? norms_->values.capacity() * sizeof(double) : 0;
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+
+// Status, rating and length of every document in struct-of-arrays columns. Documents are kept in ascending id
+// order in blocks of at most BLOCK_CAPACITY, so postings, which list documents in ascending id order too,
+// reach the attributes of theirs by moving a cursor forward rather than by a search, and a predicate over
+// all documents is evaluated column by column.
+class DocumentAttributes {
+public:
+    static const size_t BLOCK_CAPACITY = 1024;
+
+    struct Block {
+        std::vector<int> ids;
+        std::vector<DocumentStatus> statuses;
+        std::vector<int> ratings;
+        std::vector<int> lengths;
+    };
+
+    // Forward-only position over the documents in ascending id order
+    class Cursor {
+    public:
+        explicit Cursor(const DocumentAttributes& attributes);
+
+        // Moves to a present document not before the current one
+        void Seek(int document_id);
+
+        int GetDocumentId() const;
+
+        DocumentStatus GetStatus() const;
+
+        int GetRating() const;
+
+        int GetLength() const;
+
+        // Index of the document among all the slots of the blocks, BLOCK_CAPACITY per block
+        size_t GetSlot() const;
+
+    private:
+        const std::vector<Block>* blocks_;
+        size_t block_index_ = 0;
+        size_t offset_ = 0;
+    };
+
+    // The document must be absent
+    void Add(int document_id, DocumentStatus status, int rating, int length);
+
+    // Does nothing for an absent document
+    void Remove(int document_id);
+
+    // These throw std::out_of_range for an absent document
+    DocumentStatus GetStatus(int document_id) const;
+
+    int GetRating(int document_id) const;
+
+    int GetLength(int document_id) const;
+
+    size_t size() const;
+
+    const std::vector<Block>& GetBlocks() const;
+
+    size_t GetSlotCount() const;
+
+    size_t ByteSize() const;
+
+private:
+    std::vector<Block> blocks_;
+    size_t size_ = 0;
+
+    // Index of the block holding the document or where it belongs, blocks_.size() if there are no blocks
+    size_t FindBlock(int document_id) const;
+
+    // Block and offset of a present document, throws std::out_of_range otherwise
+    std::pair<const Block*, size_t> Find(int document_id) const;
+};
+
+// Per-document values a ranking policy derives from the lengths for an average document length, by slot
+struct DocumentNorms {
+    double average_document_length = 0.0;
+    std::vector<double> values;
+
+    double Get(const DocumentAttributes::Cursor& document) const {
+        return values[document.GetSlot()];
+    }
+};
+
+// Norms for the average document length queries last asked for, computed by the first of them and shared by
+// the following ones until Invalidate. Safe to use from concurrent queries.
+class DocumentNormsCache {
+public:
+    template <typename NormFunction>
+    std::shared_ptr<const DocumentNorms> Get(const DocumentAttributes& attributes, double average_document_length, NormFunction norm) const {
+        std::lock_guard guard(mutex_);
+        if (norms_ == nullptr || norms_->average_document_length != average_document_length) {
+            auto norms = std::make_shared<DocumentNorms>();
+            norms->average_document_length = average_document_length;
+            norms->values.resize(attributes.GetSlotCount());
+            const auto& blocks = attributes.GetBlocks();
+            for (size_t block_index = 0; block_index < blocks.size(); ++block_index) {
+                const std::vector<int>& lengths = blocks[block_index].lengths;
+                double* block_norms = norms->values.data() + block_index * DocumentAttributes::BLOCK_CAPACITY;
+                for (size_t offset = 0; offset < lengths.size(); ++offset) {
+                    block_norms[offset] = norm(lengths[offset]);
+                }
+            }
+            norms_ = std::move(norms);
+        }
+        return norms_;
+    }
+
+    // Called on every change of the attributes
+    void Invalidate();
+
+    size_t ByteSize() const;
+
+private:
+    mutable std::mutex mutex_;
+    mutable std::shared_ptr<const DocumentNorms> norms_;
+};
+
+// Evaluates a document predicate over candidates given by DocumentAttributes cursors. When the candidates are
+// many, the predicate is evaluated once per document over the columns into a bitmap, which is then tested
+// per candidate; otherwise it is called per candidate with the attributes at the cursor.
+template <typename DocumentPredicate>
+class PredicateFilter {
+public:
+    PredicateFilter(const DocumentAttributes& attributes, DocumentPredicate predicate, size_t candidate_count)
+            : predicate_(predicate)
+    {
+        // Scanning the columns sequentially costs about as much as this many random accesses per candidate
+        const size_t BITMAP_MIN_CANDIDATE_SHARE = 4;
+        if (candidate_count * BITMAP_MIN_CANDIDATE_SHARE < attributes.size()) {
+            return;
+        }
+        bits_.assign((attributes.GetSlotCount() + 63) / 64, 0);
+        const auto& blocks = attributes.GetBlocks();
+        for (size_t block_index = 0; block_index < blocks.size(); ++block_index) {
+            const DocumentAttributes::Block& block = blocks[block_index];
+            uint64_t* block_bits = bits_.data() + block_index * DocumentAttributes::BLOCK_CAPACITY / 64;
+            for (size_t offset = 0; offset < block.ids.size(); ++offset) {
+                const uint64_t accepted = predicate_(block.ids[offset], block.statuses[offset], block.ratings[offset]) ? 1 : 0;
+                block_bits[offset / 64] |= accepted << (offset % 64);
+            }
+        }
+        is_bitmap_ = true;
+    }
+
+    bool operator()(const DocumentAttributes::Cursor& document) const {
+        if (is_bitmap_) {
+            const size_t slot = document.GetSlot();
+            return (bits_[slot / 64] >> (slot % 64)) & 1;
+        }
+        return predicate_(document.GetDocumentId(), document.GetStatus(), document.GetRating());
+    }
+
+private:
+    DocumentPredicate predicate_;
+    std::vector<uint64_t> bits_;
+    bool is_bitmap_ = false;
+};
@@ -0,0 +1,155 @@
+#include "document_reordering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// Partitions this small are left in their order
+const size_t MIN_PARTITION_SIZE = 16;
+const int MAX_ITERATION_COUNT = 20;
+
+size_t GetVarintSize(uint64_t value) {
+    size_t size = 1;
+    for (; value >= 0x80; value >>= 7) {
+        ++size;
+    }
+    return size;
+}
+
+class GraphBisection {
+public:
+    GraphBisection(const vector<vector<uint32_t>>& document_terms, uint32_t term_count)
+            : document_terms_(document_terms)
+            , left_degrees_(term_count)
+            , right_degrees_(term_count)
+            , to_right_gains_(term_count)
+            , to_left_gains_(term_count)
+    {
+    }
+
+    void Bisect(uint32_t* begin, uint32_t* end) {
+        if (static_cast<size_t>(end - begin) <= MIN_PARTITION_SIZE) {
+            return;
+        }
+        uint32_t* middle = begin + (end - begin) / 2;
+        Refine(begin, middle, end);
+        Bisect(begin, middle);
+        Bisect(middle, end);
+    }
+
+private:
+    const vector<vector<uint32_t>>& document_terms_;
+    // Documents of every term in the two halves being refined, zero outside of Refine
+    vector<uint32_t> left_degrees_;
+    vector<uint32_t> right_degrees_;
+    vector<double> to_right_gains_;
+    vector<double> to_left_gains_;
+    vector<uint32_t> terms_;
+    vector<pair<double, uint32_t*>> left_gains_;
+    vector<pair<double, uint32_t*>> right_gains_;
+
+    // Estimated bits of the gaps of a term with degree documents in a partition of size documents
+    static double GetCost(double degree, double size) {
+        return degree * log2(size / (degree + 1.0));
+    }
+
+    void MoveDocument(uint32_t document, vector<uint32_t>& from, vector<uint32_t>& to) {
+        for (const uint32_t term : document_terms_[document]) {
+            --from[term];
+            ++to[term];
+        }
+    }
+
+    void Refine(uint32_t* begin, uint32_t* middle, uint32_t* end) {
+        terms_.clear();
+        for (uint32_t* document = begin; document != end; ++document) {
+            auto& degrees = document < middle ? left_degrees_ : right_degrees_;
+            for (const uint32_t term : document_terms_[*document]) {
+                if (left_degrees_[term] == 0 && right_degrees_[term] == 0) {
+                    terms_.push_back(term);
+                }
+                ++degrees[term];
+            }
+        }
+        const double left_size = middle - begin;
+        const double right_size = end - middle;
+
+        for (int iteration = 0; iteration < MAX_ITERATION_COUNT; ++iteration) {
+            for (const uint32_t term : terms_) {
+                const double left = left_degrees_[term];
+                const double right = right_degrees_[term];
+                const double cost = GetCost(left, left_size) + GetCost(right, right_size);
+                to_right_gains_[term] = left > 0 ? cost - GetCost(left - 1, left_size) - GetCost(right + 1, right_size) : 0.0;
+                to_left_gains_[term] = right > 0 ? cost - GetCost(left + 1, left_size) - GetCost(right - 1, right_size) : 0.0;
+            }
+            auto collect_gains = [this](uint32_t* begin, uint32_t* end, const vector<double>& term_gains, vector<pair<double, uint32_t*>>& gains) {
+                gains.clear();
+                for (uint32_t* document = begin; document != end; ++document) {
+                    double gain = 0.0;
+                    for (const uint32_t term : document_terms_[*document]) {
+                        gain += term_gains[term];
+                    }
+                    gains.emplace_back(gain, document);
+                }
+                sort(gains.begin(), gains.end(), [](const auto& lhs, const auto& rhs) {
+                    return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+                });
+            };
+            collect_gains(begin, middle, to_right_gains_, left_gains_);
+            collect_gains(middle, end, to_left_gains_, right_gains_);
+
+            size_t swap_count = 0;
+            for (; swap_count < min(left_gains_.size(), right_gains_.size()); ++swap_count) {
+                const auto [left_gain, left_document] = left_gains_[swap_count];
+                const auto [right_gain, right_document] = right_gains_[swap_count];
+                if (left_gain + right_gain <= 0.0) {
+                    break;
+                }
+                MoveDocument(*left_document, left_degrees_, right_degrees_);
+                MoveDocument(*right_document, right_degrees_, left_degrees_);
+                swap(*left_document, *right_document);
+            }
+            if (swap_count == 0) {
+                break;
+            }
+        }
+
+        for (const uint32_t term : terms_) {
+            left_degrees_[term] = 0;
+            right_degrees_[term] = 0;
+        }
+    }
+};
+
+}
+
+vector<uint32_t> ComputeClusteredOrder(const vector<vector<uint32_t>>& document_terms, uint32_t term_count) {
+    vector<uint32_t> order(document_terms.size());
+    iota(order.begin(), order.end(), 0);
+    GraphBisection(document_terms, term_count).Bisect(order.data(), order.data() + order.size());
+    return order;
+}
+
+OrdinalGapCost MeasureOrdinalGaps(const vector<vector<uint32_t>>& document_terms, uint32_t term_count, const vector<uint32_t>& order) {
+    OrdinalGapCost cost;
+    // Ordinal of the previous document of every term plus one, zero before the first
+    vector<uint32_t> next_ordinals(term_count);
+    double log_gap_sum = 0.0;
+    for (uint32_t ordinal = 0; ordinal < order.size(); ++ordinal) {
+        for (const uint32_t term : document_terms[order[ordinal]]) {
+            // The first ordinal of a term is stored as it is, the following ones as the distance to the previous
+            const uint32_t gap = next_ordinals[term] == 0 ? ordinal : ordinal - (next_ordinals[term] - 1);
+            cost.varint_bytes += GetVarintSize(gap);
+            log_gap_sum += log2(ordinal + 1.0 - next_ordinals[term]);
+            next_ordinals[term] = ordinal + 1;
+            ++cost.posting_count;
+        }
+    }
+    cost.average_log_gap = cost.posting_count > 0 ? log_gap_sum / cost.posting_count : 0.0;
+    return cost;
+}
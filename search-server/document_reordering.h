@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class DocumentOrder {
+    // Ordinals follow ascending document ids
+    BY_ID,
+    // Documents sharing terms get close ordinals, see ComputeClusteredOrder
+    CLUSTERED,
+};
+
+// Size of postings stored as the gaps between ascending document ordinals
+struct OrdinalGapCost {
+    size_t posting_count = 0;
+    // Bytes of the gaps as varints
+    size_t varint_bytes = 0;
+    // Average log2 of the gaps, the bits per posting an ideal gap coding would spend
+    double average_log_gap = 0.0;
+};
+
+struct ReorderingReport {
+    OrdinalGapCost id_order;
+    OrdinalGapCost new_order;
+};
+
+// Recursive graph bisection: the documents are split in halves, pairs of documents are swapped between the halves
+// while that lowers the estimated log-gap cost of the postings, then each half is split the same way.
+// document_terms holds the ids (less than term_count) of the distinct terms of every document;
+// returns the indexes of the documents in their new order.
+std::vector<uint32_t> ComputeClusteredOrder(const std::vector<std::vector<uint32_t>>& document_terms, uint32_t term_count);
+
+// Cost of the postings of document_terms with every document numbered by its position in order
+OrdinalGapCost MeasureOrdinalGaps(const std::vector<std::vector<uint32_t>>& document_terms, uint32_t term_count, const std::vector<uint32_t>& order);
@@ -0,0 +1,229 @@
+#include "document_store.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "lz_codec.h"
+#include "memory_usage.h"
+#include "varint.h"
+
+using namespace std;
+
+namespace {
+
+uint64_t EncodeZigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t DecodeZigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+}
+
+DocumentStore::DocumentStore(const DocumentStoreOptions& options)
+        : options_(options)
+        , cache_(make_unique<BlockCache>(options.cached_block_count))
+{
+}
+
+DocumentStore::DocumentStore(const DocumentStore& other)
+        : options_(other.options_)
+        , blocks_(other.blocks_)
+        , open_block_(other.open_block_)
+        , compressed_byte_size_(other.compressed_byte_size_)
+        , locations_(other.locations_)
+        , garbage_byte_size_(other.garbage_byte_size_)
+        , cache_(make_unique<BlockCache>(other.options_.cached_block_count))
+{
+}
+
+void DocumentStore::Add(int document_id, string_view text, const vector<int>& ratings) {
+    if (locations_.count(document_id) > 0) {
+        throw invalid_argument("Document "s + to_string(document_id) + " is already stored"s);
+    }
+    const size_t offset = open_block_.size();
+    AppendVarint(open_block_, text.size());
+    open_block_.append(text);
+    AppendVarint(open_block_, ratings.size());
+    for (const int rating : ratings) {
+        AppendVarint(open_block_, EncodeZigzag(rating));
+    }
+    locations_[document_id] = { static_cast<uint32_t>(blocks_.size()), static_cast<uint32_t>(offset),
+                                static_cast<uint32_t>(open_block_.size() - offset) };
+    if (open_block_.size() >= options_.block_size) {
+        SealOpenBlock();
+    }
+}
+
+void DocumentStore::Remove(int document_id) {
+    if (const auto it = locations_.find(document_id); it != locations_.end()) {
+        garbage_byte_size_ += it->second.size;
+        locations_.erase(it);
+    }
+}
+
+bool DocumentStore::Contains(int document_id) const {
+    return locations_.count(document_id) > 0;
+}
+
+StoredDocument DocumentStore::Get(int document_id) const {
+    const auto it = locations_.find(document_id);
+    if (it == locations_.end()) {
+        throw out_of_range("Document "s + to_string(document_id) + " is not stored"s);
+    }
+    const Location location = it->second;
+    if (location.block == blocks_.size()) {
+        return DecodeDocument(document_id, open_block_, location.offset);
+    }
+    return DecodeDocument(document_id, *cache_->Get(*this, location.block), location.offset);
+}
+
+vector<StoredDocument> DocumentStore::Get(const vector<int>& document_ids) const {
+    vector<pair<Location, size_t>> locations;
+    locations.reserve(document_ids.size());
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const auto it = locations_.find(document_ids[i]);
+        if (it == locations_.end()) {
+            throw out_of_range("Document "s + to_string(document_ids[i]) + " is not stored"s);
+        }
+        locations.emplace_back(it->second, i);
+    }
+    sort(locations.begin(), locations.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first.block < rhs.first.block;
+    });
+
+    vector<StoredDocument> documents(document_ids.size());
+    shared_ptr<const string> block;
+    uint32_t block_index = 0;
+    for (const auto& [location, index] : locations) {
+        if (location.block == blocks_.size()) {
+            documents[index] = DecodeDocument(document_ids[index], open_block_, location.offset);
+            continue;
+        }
+        if (!block || block_index != location.block) {
+            block = cache_->Get(*this, location.block);
+            block_index = location.block;
+        }
+        documents[index] = DecodeDocument(document_ids[index], *block, location.offset);
+    }
+    return documents;
+}
+
+size_t DocumentStore::GetDocumentCount() const {
+    return locations_.size();
+}
+
+size_t DocumentStore::ByteSize() const {
+    return open_block_.capacity() + compressed_byte_size_ + blocks_.capacity() * sizeof(blocks_[0])
+           + locations_.size() * (TREE_NODE_OVERHEAD + sizeof(pair<const int, Location>));
+}
+
+size_t DocumentStore::GetGarbageByteSize() const {
+    return garbage_byte_size_;
+}
+
+void DocumentStore::Compact() {
+    if (garbage_byte_size_ == 0) {
+        return;
+    }
+    DocumentStore compacted(options_);
+    for (const auto& [block_index, documents] : GroupByBlock()) {
+        const shared_ptr<const string> block = block_index == blocks_.size()
+                ? make_shared<const string>(open_block_)
+                : make_shared<const string>(DecompressBlock(blocks_[block_index]));
+        for (const auto& [document_id, location] : documents) {
+            const string_view record = string_view(*block).substr(location.offset, location.size);
+            compacted.locations_[document_id] = { static_cast<uint32_t>(compacted.blocks_.size()),
+                                                  static_cast<uint32_t>(compacted.open_block_.size()), location.size };
+            compacted.open_block_.append(record);
+            if (compacted.open_block_.size() >= options_.block_size) {
+                compacted.SealOpenBlock();
+            }
+        }
+    }
+    *this = move(compacted);
+}
+
+size_t DocumentStore::GetCacheByteSize() const {
+    return cache_->ByteSize();
+}
+
+void DocumentStore::ClearCache() {
+    cache_->Clear();
+}
+
+map<uint32_t, vector<pair<int, DocumentStore::Location>>> DocumentStore::GroupByBlock() const {
+    map<uint32_t, vector<pair<int, Location>>> blocks;
+    for (const auto& [document_id, location] : locations_) {
+        blocks[location.block].emplace_back(document_id, location);
+    }
+    return blocks;
+}
+
+void DocumentStore::SealOpenBlock() {
+    blocks_.push_back(CompressBlock(open_block_));
+    blocks_.back().shrink_to_fit();
+    compressed_byte_size_ += blocks_.back().size();
+    open_block_.clear();
+}
+
+StoredDocument DocumentStore::DecodeDocument(int document_id, string_view block, uint32_t offset) {
+    const char* current = block.data() + offset;
+    const char* end = block.data() + block.size();
+    StoredDocument document;
+    document.id = document_id;
+    const size_t text_size = ReadVarint(current, end);
+    document.text.assign(current, text_size);
+    current += text_size;
+    document.ratings.resize(ReadVarint(current, end));
+    for (int& rating : document.ratings) {
+        rating = static_cast<int>(DecodeZigzag(ReadVarint(current, end)));
+    }
+    return document;
+}
+
+DocumentStore::BlockCache::BlockCache(size_t capacity)
+        : capacity_(capacity)
+{
+}
+
+shared_ptr<const string> DocumentStore::BlockCache::Get(const DocumentStore& store, uint32_t block) const {
+    {
+        lock_guard guard(mutex_);
+        const auto it = positions_.find(block);
+        if (it != positions_.end()) {
+            blocks_.splice(blocks_.begin(), blocks_, it->second);
+            return it->second->second;
+        }
+    }
+    // Decompressed outside the lock, concurrent misses of one block may both decompress it
+    auto data = make_shared<const string>(DecompressBlock(store.blocks_[block]));
+    if (capacity_ == 0) {
+        return data;
+    }
+    lock_guard guard(mutex_);
+    if (positions_.count(block) == 0) {
+        blocks_.emplace_front(block, data);
+        positions_[block] = blocks_.begin();
+        byte_size_ += data->capacity();
+        if (blocks_.size() > capacity_) {
+            byte_size_ -= blocks_.back().second->capacity();
+            positions_.erase(blocks_.back().first);
+            blocks_.pop_back();
+        }
+    }
+    return data;
+}
+
+size_t DocumentStore::BlockCache::ByteSize() const {
+    lock_guard guard(mutex_);
+    return byte_size_;
+}
+
+void DocumentStore::BlockCache::Clear() {
+    lock_guard guard(mutex_);
+    blocks_.clear();
+    positions_.clear();
+    byte_size_ = 0;
+}
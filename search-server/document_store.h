@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct StoredDocument {
+    int id = 0;
+    std::string text;
+    std::vector<int> ratings;
+};
+
+struct DocumentStoreOptions {
+    // Documents are appended to an open block, which is compressed once it reaches this size
+    size_t block_size = 16 << 10;
+    // Decompressed blocks kept for repeated reads
+    size_t cached_block_count = 64;
+};
+
+// Original texts and ratings of documents, kept in LZ-compressed blocks (see lz_codec.h).
+// Reading a document decompresses its block unless the block is cached, so the few results
+// of a query usually cost one or two decompressions. Reads may run concurrently with each other.
+class DocumentStore {
+public:
+    explicit DocumentStore(const DocumentStoreOptions& options = {});
+
+    DocumentStore(const DocumentStore& other);
+
+    DocumentStore(DocumentStore&& other) = default;
+
+    DocumentStore& operator=(DocumentStore&& other) = default;
+
+    // Throws std::invalid_argument if the document is already stored
+    void Add(int document_id, std::string_view text, const std::vector<int>& ratings);
+
+    // The document's bytes stay in its block until Compact
+    void Remove(int document_id);
+
+    bool Contains(int document_id) const;
+
+    // Throws std::out_of_range if the document is not stored
+    StoredDocument Get(int document_id) const;
+
+    // Documents in the order of the ids, every block read once
+    std::vector<StoredDocument> Get(const std::vector<int>& document_ids) const;
+
+    size_t GetDocumentCount() const;
+
+    // Compressed blocks, the open block and document locations, without the cache
+    size_t ByteSize() const;
+
+    // Uncompressed bytes of removed documents still kept in blocks
+    size_t GetGarbageByteSize() const;
+
+    // Rewrites the blocks without removed documents
+    void Compact();
+
+    // Decompressed blocks held by the cache
+    size_t GetCacheByteSize() const;
+
+    void ClearCache();
+
+private:
+    struct Location {
+        // blocks_.size() for the open block
+        uint32_t block;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // Least recently used decompressed blocks
+    class BlockCache {
+    public:
+        explicit BlockCache(size_t capacity);
+
+        std::shared_ptr<const std::string> Get(const DocumentStore& store, uint32_t block) const;
+
+        size_t ByteSize() const;
+
+        void Clear();
+
+    private:
+        size_t capacity_;
+        mutable size_t byte_size_ = 0;
+        mutable std::mutex mutex_;
+        mutable std::list<std::pair<uint32_t, std::shared_ptr<const std::string>>> blocks_;
+        mutable std::unordered_map<uint32_t, decltype(blocks_)::iterator> positions_;
+    };
+
+    DocumentStoreOptions options_;
+    std::vector<std::vector<uint8_t>> blocks_;
+    std::string open_block_;
+    size_t compressed_byte_size_ = 0;
+    std::map<int, Location> locations_;
+    size_t garbage_byte_size_ = 0;
+    std::unique_ptr<BlockCache> cache_;
+
+    void SealOpenBlock();
+
+    // Stored documents grouped by block
+    std::map<uint32_t, std::vector<std::pair<int, Location>>> GroupByBlock() const;
+
+    static StoredDocument DecodeDocument(int document_id, std::string_view block, uint32_t offset);
+};
@@ -0,0 +1,57 @@
+#include "epoch_reclaimer.h"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+using namespace std;
+
+EpochReclaimer::~EpochReclaimer() {
+    for (auto& [epoch, deleter] : retired_) {
+        deleter();
+    }
+}
+
+EpochReclaimer::Guard EpochReclaimer::Pin() {
+    const uint64_t epoch = epoch_.load();
+    size_t index = hash<thread::id>()(this_thread::get_id()) % READER_SLOT_COUNT;
+    while (true) {
+        uint64_t free_slot = 0;
+        if (reader_slots_[index].epoch.compare_exchange_strong(free_slot, epoch)) {
+            return Guard(&reader_slots_[index].epoch);
+        }
+        index = (index + 1) % READER_SLOT_COUNT;
+    }
+}
+
+void EpochReclaimer::Retire(function<void()> deleter) {
+    // The object was unpublished before this increment, so readers pinning a later epoch cannot see it
+    const uint64_t retire_epoch = epoch_.fetch_add(1);
+    lock_guard guard(retired_mutex_);
+    retired_.emplace_back(retire_epoch, move(deleter));
+    CollectLocked();
+}
+
+void EpochReclaimer::Collect() {
+    lock_guard guard(retired_mutex_);
+    CollectLocked();
+}
+
+size_t EpochReclaimer::GetRetiredCount() const {
+    lock_guard guard(retired_mutex_);
+    return retired_.size();
+}
+
+void EpochReclaimer::CollectLocked() {
+    uint64_t oldest_pinned_epoch = numeric_limits<uint64_t>::max();
+    for (const ReaderSlot& slot : reader_slots_) {
+        const uint64_t epoch = slot.epoch.load();
+        if (epoch != 0) {
+            oldest_pinned_epoch = min(oldest_pinned_epoch, epoch);
+        }
+    }
+    while (!retired_.empty() && retired_.front().first < oldest_pinned_epoch) {
+        retired_.front().second();
+        retired_.pop_front();
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+// Epoch-based reclamation: writers retire objects they unpublished, readers pin the current epoch while they
+// may hold such objects, and a retired object is deleted once every reader pinned before its retirement has left.
+// Pinning and unpinning are a few atomic operations, readers never take a lock.
+class EpochReclaimer {
+public:
+    // Keeps the reader's epoch pinned until destroyed
+    class Guard {
+    public:
+        Guard(const Guard&) = delete;
+
+        Guard& operator=(const Guard&) = delete;
+
+        Guard(Guard&& other) noexcept
+                : slot_(std::exchange(other.slot_, nullptr)) {
+        }
+
+        ~Guard() {
+            if (slot_ != nullptr) {
+                slot_->store(0, std::memory_order_release);
+            }
+        }
+
+    private:
+        friend class EpochReclaimer;
+
+        explicit Guard(std::atomic<uint64_t>* slot)
+                : slot_(slot) {
+        }
+
+        std::atomic<uint64_t>* slot_;
+    };
+
+    EpochReclaimer() = default;
+
+    EpochReclaimer(const EpochReclaimer&) = delete;
+
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    // Deletes every retired object, no reader may be pinned anymore
+    ~EpochReclaimer();
+
+    // Pointers loaded after pinning stay valid while the guard lives.
+    // Up to READER_SLOT_COUNT readers are pinned at once, more of them spin until a slot is free.
+    Guard Pin();
+
+    // Schedules deleter to run once no reader may still see the object, which must be unreachable for new readers
+    void Retire(std::function<void()> deleter);
+
+    // Runs the deleters of retired objects no reader can see anymore, Retire does it too
+    void Collect();
+
+    // Objects retired but not deleted yet
+    size_t GetRetiredCount() const;
+
+    static constexpr size_t READER_SLOT_COUNT = 64;
+
+private:
+    // Own cache line per slot, so pinning readers do not invalidate each other
+    struct alignas(64) ReaderSlot {
+        // Epoch the reader pinned, zero for a free slot
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    std::atomic<uint64_t> epoch_{1};
+    std::array<ReaderSlot, READER_SLOT_COUNT> reader_slots_;
+    mutable std::mutex retired_mutex_;
+    // Ordered by retirement epoch
+    std::deque<std::pair<uint64_t, std::function<void()>>> retired_;
+
+    void CollectLocked();
+};
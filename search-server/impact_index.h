@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "varint.h"
+
+enum class ImpactPrecision {
+    BITS_8,
+    BITS_16,
+};
+
+// Per-posting scores quantized to Impact with one global scale, kept in ordinal order.
+// Documents are numbered by dense ordinals, in the order of the ids given; a term present in a large share
+// of the documents is stored as a dense impact array, so adding it to the scores is a contiguous loop.
+// The ordinals of the others are stored as varint gaps when these mostly take a single byte, which is the case
+// when documents sharing terms are numbered close together (see DocumentOrder), and as they are otherwise.
+template <typename Impact>
+class ImpactIndex {
+public:
+    static_assert(std::is_unsigned_v<Impact>, "Impacts must be unsigned integers");
+
+    ImpactIndex(std::vector<int> document_ids, double max_impact)
+            : document_ids_(std::move(document_ids))
+            , scale_(max_impact > 0.0 ? std::numeric_limits<Impact>::max() / max_impact : 1.0)
+    {
+    }
+
+    // Postings are (ordinal, impact) pairs in ascending ordinal order
+    void AddTerm(std::string_view term, const std::vector<std::pair<uint32_t, double>>& postings) {
+        TermImpacts& term_impacts = terms_[std::string(term)];
+        uint32_t previous = 0;
+        for (const auto& [ordinal, impact] : postings) {
+            AppendVarint(term_impacts.ordinal_gaps, ordinal - previous);
+            previous = ordinal;
+        }
+        // Decoding gaps of several bytes costs more than it saves
+        if (term_impacts.ordinal_gaps.size() >= postings.size() * MAX_GAP_BYTES_PER_POSTING) {
+            term_impacts.ordinal_gaps.clear();
+            term_impacts.ordinals.reserve(postings.size());
+            for (const auto& [ordinal, impact] : postings) {
+                term_impacts.ordinals.push_back(ordinal);
+            }
+        }
+        const size_t sparse_bytes = term_impacts.ordinal_gaps.size() + term_impacts.ordinals.size() * sizeof(uint32_t) + postings.size() * sizeof(Impact);
+        if (sparse_bytes >= document_ids_.size() * sizeof(Impact)) {
+            term_impacts.ordinal_gaps.clear();
+            term_impacts.ordinals.clear();
+            term_impacts.impacts.assign(document_ids_.size(), 0);
+            for (const auto& [ordinal, impact] : postings) {
+                term_impacts.impacts[ordinal] = Quantize(impact);
+            }
+        }
+        else {
+            term_impacts.ordinal_gaps.shrink_to_fit();
+            term_impacts.impacts.reserve(postings.size());
+            for (const auto& [ordinal, impact] : postings) {
+                term_impacts.impacts.push_back(Quantize(impact));
+            }
+        }
+    }
+
+    void Accumulate(std::string_view term, std::vector<uint32_t>& scores) const {
+        const auto it = terms_.find(term);
+        if (it == terms_.end()) {
+            return;
+        }
+        const TermImpacts& term_impacts = it->second;
+        const Impact* impacts = term_impacts.impacts.data();
+        uint32_t* out = scores.data();
+        const size_t size = term_impacts.impacts.size();
+        if (!term_impacts.ordinals.empty()) {
+            const uint32_t* ordinals = term_impacts.ordinals.data();
+            for (size_t i = 0; i < size; ++i) {
+                out[ordinals[i]] += impacts[i];
+            }
+        }
+        else if (term_impacts.ordinal_gaps.empty()) {
+            for (size_t i = 0; i < size; ++i) {
+                out[i] += impacts[i];
+            }
+        }
+        else {
+            const uint8_t* gaps = term_impacts.ordinal_gaps.data();
+            const uint8_t* gaps_end = gaps + term_impacts.ordinal_gaps.size();
+            uint32_t ordinal = 0;
+            for (size_t i = 0; i < size; ++i) {
+                // Most gaps of clustered documents take a single byte
+                if (*gaps < 0x80) {
+                    ordinal += *gaps++;
+                }
+                else {
+                    ordinal += static_cast<uint32_t>(ReadVarint(gaps, gaps_end));
+                }
+                out[ordinal] += impacts[i];
+            }
+        }
+    }
+
+    // Zeroes the scores of the documents containing the term
+    void Exclude(std::string_view term, std::vector<uint32_t>& scores) const {
+        const auto it = terms_.find(term);
+        if (it == terms_.end()) {
+            return;
+        }
+        const TermImpacts& term_impacts = it->second;
+        if (!term_impacts.ordinals.empty()) {
+            for (const uint32_t ordinal : term_impacts.ordinals) {
+                scores[ordinal] = 0;
+            }
+        }
+        else if (term_impacts.ordinal_gaps.empty()) {
+            for (size_t i = 0; i < term_impacts.impacts.size(); ++i) {
+                scores[i] = term_impacts.impacts[i] != 0 ? 0 : scores[i];
+            }
+        }
+        else {
+            const uint8_t* gaps = term_impacts.ordinal_gaps.data();
+            const uint8_t* gaps_end = gaps + term_impacts.ordinal_gaps.size();
+            uint32_t ordinal = 0;
+            while (gaps != gaps_end) {
+                ordinal += static_cast<uint32_t>(ReadVarint(gaps, gaps_end));
+                scores[ordinal] = 0;
+            }
+        }
+    }
+
+    double Dequantize(uint32_t score) const {
+        return score / scale_;
+    }
+
+    size_t GetDocumentCount() const {
+        return document_ids_.size();
+    }
+
+    int GetDocumentId(uint32_t ordinal) const {
+        return document_ids_[ordinal];
+    }
+
+    size_t ByteSize() const {
+        size_t bytes = document_ids_.capacity() * sizeof(int);
+        for (const auto& [term, term_impacts] : terms_) {
+            bytes += term.capacity() + term_impacts.ordinal_gaps.capacity() + term_impacts.ordinals.capacity() * sizeof(uint32_t)
+                     + term_impacts.impacts.capacity() * sizeof(Impact);
+        }
+        return bytes;
+    }
+
+private:
+    static constexpr size_t MAX_GAP_BYTES_PER_POSTING = 2;
+
+    struct TermImpacts {
+        // Either of them holds the ordinals of a sparse term, the gaps between ascending ordinals as varints
+        // (the first from zero) or the ordinals themselves; both are empty for dense terms,
+        // whose impacts are indexed by ordinal directly
+        std::vector<uint8_t> ordinal_gaps;
+        std::vector<uint32_t> ordinals;
+        std::vector<Impact> impacts;
+    };
+
+    std::vector<int> document_ids_;
+    std::map<std::string, TermImpacts, std::less<>> terms_;
+    double scale_;
+
+    // Never rounds a posting down to zero, zero means the document has no such term
+    Impact Quantize(double impact) const {
+        const double scaled = std::round(impact * scale_);
+        return static_cast<Impact>(std::clamp(scaled, 1.0, static_cast<double>(std::numeric_limits<Impact>::max())));
+    }
+};
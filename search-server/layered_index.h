@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "search_server.h"
+#include "document.h"
+
+// An index, such as SearchServer, as an immutable base shared by every copy plus a small delta index of the
+// documents added since and the ids of the base documents removed since. Copying it copies the delta only, so
+// a writer can publish a modified copy per update at a cost that grows with the delta instead of the whole
+// index; Compact folds the delta into a new base, copying the whole index once. Queries rank the documents of
+// both parts with statistics taken over the documents still live, so the merged results rank as a single index
+// holding them would rank them (see ShardedSearchServer).
+template <typename Index>
+class LayeredIndex {
+public:
+    // The empty index gives the stop words and options of the delta
+    LayeredIndex(Index base, const Index& empty_index)
+            : LayeredIndex(std::make_shared<const Index>(std::move(base)), std::make_shared<const Index>(empty_index)) {
+    }
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+        if (base_->HasDocument(document_id) && removed_ids_.count(document_id) == 0) {
+            throw std::invalid_argument("Invalid document_id"s);
+        }
+        delta_.AddDocument(document_id, document, status, ratings);
+        added_documents_.emplace(document_id, AddedDocument{ std::string(document), status, ratings });
+    }
+
+    void RemoveDocument(int document_id) {
+        if (added_documents_.erase(document_id) > 0) {
+            delta_.RemoveDocument(document_id);
+            return;
+        }
+        if (!base_->HasDocument(document_id) || !removed_ids_.insert(document_id).second) {
+            return;
+        }
+        removed_length_ += base_->GetDocumentLength(document_id);
+        for (const auto [word, _] : base_->GetWordFrequencies(document_id)) {
+            ++removed_document_freqs_[std::string(word)];
+        }
+    }
+
+    void RemoveDocuments(const std::vector<int>& document_ids) {
+        for (const int document_id : document_ids) {
+            RemoveDocument(document_id);
+        }
+    }
+
+    // Documents added or removed since the base was built
+    size_t GetDeltaSize() const {
+        return added_documents_.size() + removed_ids_.size();
+    }
+
+    // The same documents in a new base with an empty delta, the only operation that copies the whole index
+    LayeredIndex Compact() const {
+        auto base = std::make_shared<Index>(*base_);
+        base->RemoveDocuments(std::vector<int>(removed_ids_.begin(), removed_ids_.end()));
+        for (const auto& [document_id, document] : added_documents_) {
+            base->AddDocument(document_id, document.text, document.status, document.ratings);
+        }
+        return LayeredIndex(std::move(base), empty_index_);
+    }
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+        const CollectionStatistics collection = GetQueryStatistics(raw_query);
+        std::vector<Document> documents = base_->FindTopDocuments(raw_query, [&](int document_id, DocumentStatus status, int rating) {
+            return removed_ids_.count(document_id) == 0 && document_predicate(document_id, status, rating);
+        }, collection);
+        if (!added_documents_.empty()) {
+            const std::vector<Document> delta_documents = delta_.FindTopDocuments(raw_query, document_predicate, collection);
+            documents.insert(documents.end(), delta_documents.begin(), delta_documents.end());
+            std::sort(documents.begin(), documents.end(), Index::IsRankedBefore);
+            if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+                documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+            }
+        }
+        return documents;
+    }
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+        return FindTopDocuments(raw_query, [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        });
+    }
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const {
+        return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+    }
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const {
+        if (added_documents_.count(document_id) > 0) {
+            return delta_.MatchDocument(raw_query, document_id);
+        }
+        if (removed_ids_.count(document_id) > 0) {
+            throw std::out_of_range("Unknown document id "s + std::to_string(document_id));
+        }
+        return base_->MatchDocument(raw_query, document_id);
+    }
+
+    // Statistics of the live documents of both parts
+    CollectionStatistics GetQueryStatistics(std::string_view raw_query) const {
+        CollectionStatistics statistics = base_->GetQueryStatistics(raw_query);
+        if (!removed_ids_.empty()) {
+            const double total_length = statistics.corpus.average_document_length * statistics.corpus.document_count - removed_length_;
+            statistics.corpus.document_count -= static_cast<int>(removed_ids_.size());
+            statistics.corpus.average_document_length = statistics.corpus.document_count == 0 ? 0.0 : total_length / statistics.corpus.document_count;
+            for (auto& [word, document_freq] : statistics.document_freqs) {
+                if (const auto it = removed_document_freqs_.find(word); it != removed_document_freqs_.end()) {
+                    document_freq -= it->second;
+                }
+            }
+        }
+        if (added_documents_.empty()) {
+            return statistics;
+        }
+        return MergeStatistics({ statistics, delta_.GetQueryStatistics(raw_query) });
+    }
+
+    int GetDocumentCount() const {
+        return base_->GetDocumentCount() - static_cast<int>(removed_ids_.size()) + delta_.GetDocumentCount();
+    }
+
+    bool HasDocument(int document_id) const {
+        return added_documents_.count(document_id) > 0 || (base_->HasDocument(document_id) && removed_ids_.count(document_id) == 0);
+    }
+
+    // The base and the delta; the base may still hold removed documents
+    const Index& GetBase() const {
+        return *base_;
+    }
+
+    const Index& GetDelta() const {
+        return delta_;
+    }
+
+private:
+    struct AddedDocument {
+        std::string text;
+        DocumentStatus status;
+        std::vector<int> ratings;
+    };
+
+    LayeredIndex(std::shared_ptr<const Index> base, std::shared_ptr<const Index> empty_index)
+            : base_(std::move(base))
+            , empty_index_(std::move(empty_index))
+            , delta_(*empty_index_) {
+    }
+
+    std::shared_ptr<const Index> base_;
+    std::shared_ptr<const Index> empty_index_;
+    Index delta_;
+    // Kept to fold the delta into the next base
+    std::map<int, AddedDocument> added_documents_;
+    // Removed base documents, with what they still count for in the statistics of the base
+    std::set<int> removed_ids_;
+    int64_t removed_length_ = 0;
+    std::map<std::string, int, std::less<>> removed_document_freqs_;
+};
@@ -0,0 +1,49 @@
+#include "levenshtein_automaton.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+LevenshteinAutomaton::LevenshteinAutomaton(string_view word, int max_distance)
+        : word_(word)
+        , max_distance_(static_cast<uint8_t>(max_distance))
+{
+    if (max_distance < 0 || max_distance > 4) {
+        throw invalid_argument("Edit distance must be from 0 to 4"s);
+    }
+}
+
+LevenshteinAutomaton::State LevenshteinAutomaton::Start() const {
+    // Distances are capped at max_distance + 1, which keeps them in a byte
+    State state(word_.size() + 1);
+    for (size_t i = 0; i < state.size(); ++i) {
+        state[i] = static_cast<uint8_t>(min<size_t>(i, max_distance_ + 1));
+    }
+    return state;
+}
+
+LevenshteinAutomaton::State LevenshteinAutomaton::Step(const State& state, char c) const {
+    const uint8_t cap = max_distance_ + 1;
+    State next(state.size());
+    next[0] = min<uint8_t>(state[0] + 1, cap);
+    for (size_t i = 1; i < state.size(); ++i) {
+        const uint8_t substitution = state[i - 1] + (word_[i - 1] == c ? 0 : 1);
+        const uint8_t insertion = state[i] + 1;
+        const uint8_t deletion = next[i - 1] + 1;
+        next[i] = min({ substitution, insertion, deletion, cap });
+    }
+    return next;
+}
+
+bool LevenshteinAutomaton::IsMatch(const State& state) const {
+    return state.back() <= max_distance_;
+}
+
+bool LevenshteinAutomaton::CanMatch(const State& state) const {
+    return *min_element(state.begin(), state.end()) <= max_distance_;
+}
+
+int LevenshteinAutomaton::GetDistance(const State& state) const {
+    return state.back();
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Accepts the strings within max_distance edits (insertions, deletions, substitutions) of a word.
+// A state is a row of the edit distance table, so the automaton is fed one character at a time
+// and a sorted dictionary can skip every term that extends a prefix no match starts with.
+class LevenshteinAutomaton {
+public:
+    using State = std::vector<uint8_t>;
+
+    LevenshteinAutomaton(std::string_view word, int max_distance);
+
+    State Start() const;
+
+    State Step(const State& state, char c) const;
+
+    // The input read so far is within the distance of the word
+    bool IsMatch(const State& state) const;
+
+    // Some continuation of the input read so far may still match
+    bool CanMatch(const State& state) const;
+
+    // Edits between the word and the input read so far, more than the maximum reported as max_distance + 1
+    int GetDistance(const State& state) const;
+
+private:
+    std::string word_;
+    uint8_t max_distance_;
+};
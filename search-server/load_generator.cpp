@@ -0,0 +1,379 @@
+#include "load_generator.h"
+
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+string_view NextToken(string_view& text) {
+    const size_t begin = min(text.find_first_not_of(' '), text.size());
+    text.remove_prefix(begin);
+    const size_t end = min(text.find(' '), text.size());
+    const string_view token = text.substr(0, end);
+    text.remove_prefix(end);
+    return token;
+}
+
+string_view TrimLeft(string_view text) {
+    text.remove_prefix(min(text.find_first_not_of(' '), text.size()));
+    return text;
+}
+
+int ParseInt(string_view text) {
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc() || end != text.data() + text.size()) {
+        throw invalid_argument("Invalid number "s + string(text));
+    }
+    return value;
+}
+
+LatencySummary Summarize(vector<double>& latencies) {
+    LatencySummary summary;
+    summary.count = latencies.size();
+    if (latencies.empty()) {
+        return summary;
+    }
+    sort(latencies.begin(), latencies.end());
+    // Nearest rank: the smallest latency at least the given fraction of the requests did not exceed
+    auto percentile = [&latencies](double fraction) {
+        const size_t rank = static_cast<size_t>(ceil(fraction * static_cast<double>(latencies.size())));
+        return latencies[max<size_t>(rank, 1) - 1];
+    };
+    double total = 0.0;
+    for (const double latency : latencies) {
+        total += latency;
+    }
+    summary.mean = total / static_cast<double>(latencies.size());
+    summary.p50 = percentile(0.5);
+    summary.p90 = percentile(0.9);
+    summary.p99 = percentile(0.99);
+    summary.p999 = percentile(0.999);
+    summary.max = latencies.back();
+    return summary;
+}
+
+void PrintLatencySummary(ostream& out, string_view name, const LatencySummary& summary) {
+    out << name << ": mean "s << summary.mean
+        << " p50 "s << summary.p50
+        << " p90 "s << summary.p90
+        << " p99 "s << summary.p99
+        << " p99.9 "s << summary.p999
+        << " max "s << summary.max << " us"s << endl;
+}
+
+}
+
+bool LoadRequest::IsWrite() const {
+    return type == Type::ADD || type == Type::REMOVE;
+}
+
+LoadRequest ParseLoadRequest(string_view line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    LoadRequest request;
+    string_view arguments = line;
+    const string_view command = NextToken(arguments);
+    if (command == "SEARCH"sv || command == "SEARCHALL"sv) {
+        request.type = command == "SEARCH"sv ? LoadRequest::Type::SEARCH : LoadRequest::Type::SEARCH_ALL;
+        request.text = TrimLeft(arguments);
+    }
+    else if (command == "ADD"sv) {
+        request.type = LoadRequest::Type::ADD;
+        request.document_id = ParseInt(NextToken(arguments));
+        request.status = ParseDocumentStatus(NextToken(arguments));
+        string_view ratings_text = NextToken(arguments);
+        if (ratings_text == "-"sv) {
+            ratings_text = {};
+        }
+        while (!ratings_text.empty()) {
+            const size_t comma = min(ratings_text.find(','), ratings_text.size());
+            request.ratings.push_back(ParseInt(ratings_text.substr(0, comma)));
+            ratings_text.remove_prefix(min(comma + 1, ratings_text.size()));
+        }
+        request.text = TrimLeft(arguments);
+    }
+    else if (command == "REMOVE"sv) {
+        request.type = LoadRequest::Type::REMOVE;
+        request.document_id = ParseInt(NextToken(arguments));
+    }
+    else {
+        request.text = TrimLeft(line);
+    }
+    return request;
+}
+
+string FormatLoadRequest(const LoadRequest& request) {
+    string line;
+    switch (request.type) {
+        case LoadRequest::Type::SEARCH:
+            line = "SEARCH "s + request.text;
+            break;
+        case LoadRequest::Type::SEARCH_ALL:
+            line = "SEARCHALL "s + request.text;
+            break;
+        case LoadRequest::Type::ADD: {
+            line = "ADD "s + to_string(request.document_id) + ' ' + string(GetStatusName(request.status)) + ' ';
+            if (request.ratings.empty()) {
+                line += '-';
+            }
+            for (size_t i = 0; i < request.ratings.size(); ++i) {
+                if (i > 0) {
+                    line += ',';
+                }
+                line += to_string(request.ratings[i]);
+            }
+            line += ' ';
+            line += request.text;
+            break;
+        }
+        case LoadRequest::Type::REMOVE:
+            line = "REMOVE "s + to_string(request.document_id);
+            break;
+    }
+    return line;
+}
+
+ZipfDistribution::ZipfDistribution(size_t size, double exponent) {
+    if (size == 0) {
+        throw invalid_argument("Zipf distribution over no values"s);
+    }
+    cumulative_.reserve(size);
+    double total = 0.0;
+    for (size_t rank = 1; rank <= size; ++rank) {
+        total += 1.0 / pow(static_cast<double>(rank), exponent);
+        cumulative_.push_back(total);
+    }
+}
+
+vector<LoadRequest> GenerateRequests(const vector<LoadRequest>& query_log, const LoadMix& mix, size_t count, uint64_t seed) {
+    if (mix.vocabulary.empty() && (query_log.empty() || mix.write_ratio > 0.0)) {
+        throw invalid_argument("Generated requests need a vocabulary"s);
+    }
+    mt19937_64 generator(seed);
+    optional<ZipfDistribution> words;
+    if (!mix.vocabulary.empty()) {
+        words.emplace(mix.vocabulary.size(), mix.zipf_exponent);
+    }
+    auto append_words = [&](string& text, size_t word_count) {
+        for (size_t i = 0; i < word_count; ++i) {
+            if (!text.empty()) {
+                text += ' ';
+            }
+            text += mix.vocabulary[(*words)(generator)];
+        }
+    };
+    bernoulli_distribution is_write(mix.write_ratio);
+    bernoulli_distribution is_remove(0.5);
+    uniform_int_distribution<size_t> query_word_count(1, max<size_t>(mix.max_query_words, 1));
+    uniform_int_distribution<int> rating(1, 10);
+
+    // Documents added by the requests so far and not removed yet, oldest first
+    deque<int> added_document_ids;
+    int next_document_id = mix.first_document_id;
+    size_t log_position = 0;
+
+    vector<LoadRequest> requests(count);
+    for (LoadRequest& request : requests) {
+        if (is_write(generator)) {
+            if (!added_document_ids.empty() && is_remove(generator)) {
+                request.type = LoadRequest::Type::REMOVE;
+                request.document_id = added_document_ids.front();
+                added_document_ids.pop_front();
+            }
+            else {
+                request.type = LoadRequest::Type::ADD;
+                request.document_id = next_document_id++;
+                request.ratings = { rating(generator) };
+                append_words(request.text, mix.document_words);
+                added_document_ids.push_back(request.document_id);
+            }
+        }
+        else if (!query_log.empty()) {
+            request = query_log[log_position];
+            log_position = (log_position + 1) % query_log.size();
+        }
+        else {
+            append_words(request.text, query_word_count(generator));
+        }
+    }
+    return requests;
+}
+
+double LoadReport::GetThroughput() const {
+    return elapsed.count() > 0.0 ? static_cast<double>(completed_count) / elapsed.count() : 0.0;
+}
+
+LoadReport RunLoad(const vector<LoadRequest>& requests, const LoadOptions& options, const LoadExecutor& execute) {
+    if (options.target_qps <= 0.0 || options.concurrency == 0) {
+        throw invalid_argument("Load needs a positive rate and concurrency"s);
+    }
+    using Clock = chrono::steady_clock;
+
+    // Arrival times are fixed before the first request is sent, so that a slow response delays the requests
+    // after it without moving their arrivals
+    vector<chrono::nanoseconds> arrivals(requests.size());
+    {
+        mt19937_64 generator(options.seed);
+        exponential_distribution<double> gap(options.target_qps);
+        double time = 0.0;
+        for (size_t i = 0; i < arrivals.size(); ++i) {
+            arrivals[i] = chrono::duration_cast<chrono::nanoseconds>(chrono::duration<double>(time));
+            time += options.poisson_arrivals ? gap(generator) : 1.0 / options.target_qps;
+        }
+    }
+
+    // Each request is measured by the single worker executing it, so the slots need no synchronization
+    vector<double> latencies(requests.size());
+    vector<double> service_times(requests.size());
+    vector<char> is_failed(requests.size());
+    vector<Clock::time_point> worker_finish_times(options.concurrency);
+    atomic<size_t> next_request{0};
+
+    const Clock::time_point start = Clock::now() + chrono::milliseconds(10);
+    auto work = [&](size_t worker) {
+        Clock::time_point finish = start;
+        for (size_t i = next_request++; i < requests.size(); i = next_request++) {
+            const Clock::time_point arrival = start + arrivals[i];
+            this_thread::sleep_until(arrival);
+            const Clock::time_point sent = Clock::now();
+            try {
+                execute(worker, requests[i]);
+            }
+            catch (const exception&) {
+                is_failed[i] = 1;
+            }
+            finish = Clock::now();
+            latencies[i] = chrono::duration<double, micro>(finish - arrival).count();
+            service_times[i] = chrono::duration<double, micro>(finish - sent).count();
+        }
+        worker_finish_times[worker] = finish;
+    };
+    vector<thread> workers;
+    workers.reserve(options.concurrency - 1);
+    for (size_t worker = 1; worker < options.concurrency; ++worker) {
+        workers.emplace_back(work, worker);
+    }
+    work(0);
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+    LoadReport report;
+    report.elapsed = *max_element(worker_finish_times.begin(), worker_finish_times.end()) - start;
+    vector<double> reads, writes, read_service, write_service;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (is_failed[i]) {
+            ++report.error_count;
+            continue;
+        }
+        ++report.completed_count;
+        if (requests[i].IsWrite()) {
+            writes.push_back(latencies[i]);
+            write_service.push_back(service_times[i]);
+        }
+        else {
+            reads.push_back(latencies[i]);
+            read_service.push_back(service_times[i]);
+        }
+    }
+    report.reads = Summarize(reads);
+    report.writes = Summarize(writes);
+    report.read_service = Summarize(read_service);
+    report.write_service = Summarize(write_service);
+    return report;
+}
+
+void PrintLoadReport(ostream& out, const LoadReport& report) {
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << fixed << setprecision(1);
+    out << report.completed_count << " requests in "s << report.elapsed.count() << " s, "s
+        << report.GetThroughput() << " per second, "s << report.error_count << " failed"s << endl;
+    if (report.reads.count > 0) {
+        out << report.reads.count << " reads"s << endl;
+        PrintLatencySummary(out, "  latency"sv, report.reads);
+        PrintLatencySummary(out, "  service time"sv, report.read_service);
+    }
+    if (report.writes.count > 0) {
+        out << report.writes.count << " writes"s << endl;
+        PrintLatencySummary(out, "  latency"sv, report.writes);
+        PrintLatencySummary(out, "  service time"sv, report.write_service);
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+QueryClient::QueryClient(uint16_t port) {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+        throw runtime_error("socket: "s + strerror(errno));
+    }
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        const string error = strerror(errno);
+        close(fd_);
+        throw runtime_error("Cannot connect to port "s + to_string(port) + ": "s + error);
+    }
+    const int enable = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+QueryClient::~QueryClient() {
+    close(fd_);
+}
+
+string QueryClient::Execute(const LoadRequest& request) {
+    const string line = FormatLoadRequest(request) + '\n';
+    for (size_t offset = 0; offset < line.size();) {
+        const ssize_t result = send(fd_, line.data() + offset, line.size() - offset, MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("send: "s + strerror(errno));
+        }
+        offset += static_cast<size_t>(result);
+    }
+
+    size_t line_end = input_.find('\n');
+    while (line_end == string::npos) {
+        char chunk[1 << 16];
+        const ssize_t result = recv(fd_, chunk, sizeof(chunk), 0);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw runtime_error("Connection to the query server closed"s);
+        }
+        const size_t searched = input_.size();
+        input_.append(chunk, static_cast<size_t>(result));
+        line_end = input_.find('\n', searched);
+    }
+    string response = input_.substr(0, line_end);
+    input_.erase(0, line_end + 1);
+    if (response.compare(0, 3, "ERR"s) == 0) {
+        throw runtime_error(response);
+    }
+    return response;
+}
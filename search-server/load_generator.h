@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// One request of a load test, as the query server protocol spells it (see query_server.h)
+struct LoadRequest {
+    enum class Type {
+        SEARCH,
+        SEARCH_ALL,
+        ADD,
+        REMOVE,
+    };
+
+    Type type = Type::SEARCH;
+    // Query of a search, text of an added document
+    std::string text;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+
+    bool IsWrite() const;
+};
+
+// Parses a line of a query log: a request of the query server protocol, or a bare query to search for.
+// Throws std::invalid_argument for a malformed ADD or REMOVE.
+LoadRequest ParseLoadRequest(std::string_view line);
+
+// The request line of the query server protocol, without the line break
+std::string FormatLoadRequest(const LoadRequest& request);
+
+// Draws ranks from 0 to size - 1 with probabilities proportional to 1 / (rank + 1)^exponent
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t size, double exponent);
+
+    template <typename Generator>
+    size_t operator()(Generator& generator) const {
+        const double value = std::uniform_real_distribution<double>(0.0, cumulative_.back())(generator);
+        return std::min<size_t>(std::upper_bound(cumulative_.begin(), cumulative_.end(), value) - cumulative_.begin(),
+                                cumulative_.size() - 1);
+    }
+
+private:
+    std::vector<double> cumulative_;
+};
+
+struct LoadMix {
+    // Fraction of the requests adding or removing documents, the rest are searches
+    double write_ratio = 0.0;
+    // Words of generated queries and documents, most frequent first
+    std::vector<std::string> vocabulary;
+    double zipf_exponent = 1.0;
+    size_t max_query_words = 3;
+    size_t document_words = 20;
+    // Added documents are numbered from it; a write removes the oldest of them or adds one, evenly
+    int first_document_id = 1 << 30;
+};
+
+// Requests of a load test: the searches of the query log in a loop, or Zipfian queries over the vocabulary if
+// the log is empty, with generated writes mixed in at the write ratio. Writes of the log are replayed as they are.
+std::vector<LoadRequest> GenerateRequests(const std::vector<LoadRequest>& query_log, const LoadMix& mix, size_t count, uint64_t seed);
+
+struct LoadOptions {
+    double target_qps = 1000.0;
+    // Requests sent at once at most, each by its own worker
+    size_t concurrency = 8;
+    // Exponential gaps between arrivals, like independent clients; otherwise the arrivals are evenly spaced
+    bool poisson_arrivals = true;
+    uint64_t seed = 1;
+};
+
+// Executes a request on behalf of a worker, from 0 to concurrency - 1; throws if the request failed.
+// Called from all the workers at once.
+using LoadExecutor = std::function<void(size_t worker, const LoadRequest& request)>;
+
+// Latencies in microseconds
+struct LatencySummary {
+    size_t count = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double p999 = 0.0;
+    double max = 0.0;
+};
+
+struct LoadReport {
+    std::chrono::duration<double> elapsed{0.0};
+    size_t completed_count = 0;
+    size_t error_count = 0;
+    // From the time the schedule meant a request to be sent, so that the requests delayed behind slow ones
+    // count the delay too (coordinated omission corrected)
+    LatencySummary reads;
+    LatencySummary writes;
+    // From the time a request was actually sent, what a closed-loop benchmark would report
+    LatencySummary read_service;
+    LatencySummary write_service;
+
+    double GetThroughput() const;
+};
+
+// Sends the requests open-loop: every request has its arrival time on a schedule at the target rate, fixed in
+// advance, and is sent then or as soon as a worker is free, however slowly the earlier ones were answered
+LoadReport RunLoad(const std::vector<LoadRequest>& requests, const LoadOptions& options, const LoadExecutor& execute);
+
+void PrintLoadReport(std::ostream& out, const LoadReport& report);
+
+// Client of one connection to a query server on the loopback interface
+class QueryClient {
+public:
+    explicit QueryClient(uint16_t port);
+
+    QueryClient(const QueryClient&) = delete;
+
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    ~QueryClient();
+
+    // Sends the request and returns the response line without the line break.
+    // Throws std::runtime_error if the connection fails or the server answers with ERR.
+    std::string Execute(const LoadRequest& request);
+
+private:
+    int fd_;
+    std::string input_;
+};
@@ -0,0 +1,89 @@
+#include "lz_codec.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "varint.h"
+
+using namespace std;
+
+namespace {
+
+const size_t MIN_MATCH_LENGTH = 4;
+const size_t HASH_BITS = 12;
+const size_t MAX_DISTANCE = 1 << 16;
+
+uint32_t HashFourBytes(const char* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+}
+
+vector<uint8_t> CompressBlock(string_view data) {
+    vector<uint8_t> block;
+    block.reserve(data.size() / 2 + 16);
+    AppendVarint(block, data.size());
+
+    // Last position of every hashed four-byte sequence, plus one so that zero means none
+    vector<uint32_t> last_positions(size_t(1) << HASH_BITS, 0);
+    size_t literal_begin = 0;
+    size_t position = 0;
+    while (position + MIN_MATCH_LENGTH <= data.size()) {
+        const uint32_t hash = HashFourBytes(data.data() + position);
+        const size_t candidate = last_positions[hash];
+        last_positions[hash] = static_cast<uint32_t>(position + 1);
+        if (candidate == 0 || position - (candidate - 1) > MAX_DISTANCE
+                || memcmp(data.data() + candidate - 1, data.data() + position, MIN_MATCH_LENGTH) != 0) {
+            ++position;
+            continue;
+        }
+        const size_t match_begin = candidate - 1;
+        size_t match_length = MIN_MATCH_LENGTH;
+        while (position + match_length < data.size() && data[match_begin + match_length] == data[position + match_length]) {
+            ++match_length;
+        }
+
+        AppendVarint(block, position - literal_begin);
+        block.insert(block.end(), data.begin() + literal_begin, data.begin() + position);
+        AppendVarint(block, match_length - MIN_MATCH_LENGTH);
+        AppendVarint(block, position - match_begin);
+
+        position += match_length;
+        literal_begin = position;
+    }
+    AppendVarint(block, data.size() - literal_begin);
+    block.insert(block.end(), data.begin() + literal_begin, data.end());
+    return block;
+}
+
+string DecompressBlock(const vector<uint8_t>& block) {
+    const uint8_t* current = block.data();
+    const uint8_t* end = block.data() + block.size();
+    const size_t size = ReadVarint(current, end);
+    string data;
+    data.reserve(size);
+    while (true) {
+        const size_t literal_length = ReadVarint(current, end);
+        if (literal_length > static_cast<size_t>(end - current) || data.size() + literal_length > size) {
+            throw invalid_argument("Corrupt compressed block"s);
+        }
+        data.append(reinterpret_cast<const char*>(current), literal_length);
+        current += literal_length;
+        if (data.size() == size) {
+            break;
+        }
+        const size_t match_length = ReadVarint(current, end) + MIN_MATCH_LENGTH;
+        const size_t distance = ReadVarint(current, end);
+        if (distance == 0 || distance > data.size() || data.size() + match_length > size) {
+            throw invalid_argument("Corrupt compressed block"s);
+        }
+        // Byte by byte, since a match may overlap the bytes it produces
+        const size_t match_begin = data.size() - distance;
+        for (size_t i = 0; i < match_length; ++i) {
+            data.push_back(data[match_begin + i]);
+        }
+    }
+    return data;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Byte-oriented LZ77 compression of small blocks: a block is a sequence of literal runs, each but the last
+// followed by a back-reference (length, distance) into the data decoded so far. All numbers are varints.
+
+std::vector<uint8_t> CompressBlock(std::string_view data);
+
+// Throws std::invalid_argument if the block is corrupt
+std::string DecompressBlock(const std::vector<uint8_t>& block);
@@ -0,0 +1,14 @@
+#include "memory_usage.h"
+
+#include <algorithm>
+
+using namespace std;
+
+size_t GetAllocationBytes(size_t size) {
+    // A size word before the block, rounded up to 16 bytes, 32 bytes at least, as glibc malloc does
+    return size == 0 ? 0 : max<size_t>(32, (size + sizeof(size_t) + 15) / 16 * 16);
+}
+
+size_t MemoryUsage::Total() const {
+    return lexicon + postings + forward_index + document_metadata + document_store + caches;
+}
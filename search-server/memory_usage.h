@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+
+// Estimated heap bytes of a std::map or std::set node beyond its value: links, color and allocator header
+const size_t TREE_NODE_OVERHEAD = 48;
+
+// Estimated bytes the allocator takes for a block of size bytes, its header and alignment included
+size_t GetAllocationBytes(size_t size);
+
+// Estimated heap bytes of the parts of an index
+struct MemoryUsage {
+    // Word pool, term dictionary and the per-term entries of the inverted and positional indexes
+    size_t lexicon = 0;
+    // Inverted index postings, word positions and sealed impacts
+    size_t postings = 0;
+    size_t forward_index = 0;
+    // Ratings, statuses and lengths of documents
+    size_t document_metadata = 0;
+    // Compressed texts and ratings
+    size_t document_store = 0;
+    // Decompressed document store blocks, results of hot single-word queries and document norms of the ranking
+    size_t caches = 0;
+
+    size_t Total() const;
+};
@@ -2,6 +2,11 @@
 #include <iostream>
 #include <cassert>
 #include <vector>
+#include <optional>
+#include <iterator>
+#include <type_traits>
+
+#include "document.h"
 
 template <typename Iterator>
 class IteratorRange {
@@ -71,4 +76,82 @@ private:
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
-}
\ No newline at end of file
+}
+// Pages over a result stream: fetcher(after) returns a SearchPage-like value with .documents and .next,
+// and each page is requested only when the iteration reaches it
+template <typename PageFetcher>
+class LazyPaginator {
+public:
+    using Page = std::invoke_result_t<PageFetcher&, const std::optional<SearchCursor>&>;
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::vector<Document>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        Iterator() = default;
+
+        explicit Iterator(PageFetcher* fetcher)
+                : fetcher_(fetcher)
+                , page_((*fetcher_)(std::nullopt)) {
+            if (page_.documents.empty()) {
+                fetcher_ = nullptr;
+            }
+        }
+
+        reference operator*() const {
+            return page_.documents;
+        }
+
+        pointer operator->() const {
+            return &page_.documents;
+        }
+
+        Iterator& operator++() {
+            if (!page_.next) {
+                fetcher_ = nullptr;
+                return *this;
+            }
+            page_ = (*fetcher_)(page_.next);
+            if (page_.documents.empty()) {
+                fetcher_ = nullptr;
+            }
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return fetcher_ == other.fetcher_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        PageFetcher* fetcher_ = nullptr;
+        Page page_;
+    };
+
+    explicit LazyPaginator(PageFetcher fetcher)
+            : fetcher_(std::move(fetcher)) {
+    }
+
+    Iterator begin() {
+        return Iterator(&fetcher_);
+    }
+
+    Iterator end() {
+        return Iterator();
+    }
+
+private:
+    PageFetcher fetcher_;
+};
+
+template <typename PageFetcher>
+auto PaginateLazily(PageFetcher fetcher) {
+    return LazyPaginator<PageFetcher>(std::move(fetcher));
+}
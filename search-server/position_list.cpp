@@ -0,0 +1,55 @@
+#include "position_list.h"
+#include "varint.h"
+
+using namespace std;
+
+PositionList::PositionList(const vector<uint32_t>& positions) {
+    uint32_t previous = 0;
+    for (const uint32_t position : positions) {
+        AppendVarint(bytes_, position - previous);
+        previous = position;
+    }
+    bytes_.shrink_to_fit();
+}
+
+vector<uint32_t> PositionList::Decode() const {
+    vector<uint32_t> positions;
+    for (Reader reader(*this); !reader.AtEnd(); reader.Next()) {
+        positions.push_back(reader.Value());
+    }
+    return positions;
+}
+
+size_t PositionList::ByteSize() const {
+    return bytes_.size();
+}
+
+PositionList::Reader::Reader(const PositionList& list)
+        : current_(list.bytes_.data())
+        , end_(list.bytes_.data() + list.bytes_.size())
+{
+    Next();
+}
+
+bool PositionList::Reader::AtEnd() const {
+    return at_end_;
+}
+
+uint32_t PositionList::Reader::Value() const {
+    return value_;
+}
+
+void PositionList::Reader::Next() {
+    if (current_ == end_) {
+        at_end_ = true;
+        return;
+    }
+    value_ += static_cast<uint32_t>(ReadVarint(current_, end_));
+}
+
+bool PositionList::Reader::AdvanceTo(uint32_t target) {
+    while (!at_end_ && value_ < target) {
+        Next();
+    }
+    return !at_end_;
+}
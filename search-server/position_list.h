@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Ascending word positions of a term in a document, stored as varint-encoded deltas
+class PositionList {
+public:
+    PositionList() = default;
+
+    explicit PositionList(const std::vector<uint32_t>& positions);
+
+    class Reader {
+    public:
+        explicit Reader(const PositionList& list);
+
+        bool AtEnd() const;
+
+        uint32_t Value() const;
+
+        void Next();
+
+        // Moves to the first position not less than target, returns false if there is none
+        bool AdvanceTo(uint32_t target);
+
+    private:
+        const uint8_t* current_;
+        const uint8_t* end_;
+        uint32_t value_ = 0;
+        bool at_end_ = false;
+    };
+
+    std::vector<uint32_t> Decode() const;
+
+    size_t ByteSize() const;
+
+private:
+    std::vector<uint8_t> bytes_;
+};
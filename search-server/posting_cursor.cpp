@@ -0,0 +1,38 @@
+#include "posting_cursor.h"
+
+using namespace std;
+
+PostingCursor::PostingCursor(const map<int, double>& postings)
+        : postings_(&postings)
+        , current_(postings.begin())
+{
+}
+
+bool PostingCursor::AtEnd() const {
+    return current_ == postings_->end();
+}
+
+int PostingCursor::DocumentId() const {
+    return current_->first;
+}
+
+double PostingCursor::TermFreq() const {
+    return current_->second;
+}
+
+bool PostingCursor::AdvanceTo(int document_id) {
+    for (int step = 0; step < MAX_STEP_COUNT; ++step) {
+        if (AtEnd() || current_->first >= document_id) {
+            return !AtEnd();
+        }
+        ++current_;
+    }
+    if (!AtEnd() && current_->first < document_id) {
+        current_ = postings_->lower_bound(document_id);
+    }
+    return !AtEnd();
+}
+
+size_t PostingCursor::size() const {
+    return postings_->size();
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <map>
+
+// Forward-only position in the postings of a term, in ascending document id order
+class PostingCursor {
+public:
+    explicit PostingCursor(const std::map<int, double>& postings);
+
+    bool AtEnd() const;
+
+    int DocumentId() const;
+
+    double TermFreq() const;
+
+    // Moves to the first posting of a document not less than document_id, returns false if there is none.
+    // Close targets are reached by stepping, distant ones by a search of the tree, which skips the postings between.
+    bool AdvanceTo(int document_id);
+
+    size_t size() const;
+
+private:
+    static const int MAX_STEP_COUNT = 4;
+
+    const std::map<int, double>* postings_;
+    std::map<int, double>::const_iterator current_;
+};
@@ -0,0 +1,374 @@
+#include "query_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <execution>
+#include <numeric>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const size_t MAX_LINE_SIZE = 1 << 20;
+const size_t OUTPUT_BUFFER_SIZE = 1 << 16;
+
+void ThrowSystemError(const string& what) {
+    throw runtime_error(what + ": "s + strerror(errno));
+}
+
+string_view NextToken(string_view& text) {
+    const size_t begin = min(text.find_first_not_of(' '), text.size());
+    text.remove_prefix(begin);
+    const size_t end = min(text.find(' '), text.size());
+    const string_view token = text.substr(0, end);
+    text.remove_prefix(end);
+    return token;
+}
+
+int ParseInt(string_view text) {
+    int value = 0;
+    const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+    if (error != errc() || end != text.data() + text.size()) {
+        throw invalid_argument("Invalid number "s + string(text));
+    }
+    return value;
+}
+
+template <typename Number>
+void AppendNumber(string& out, Number value) {
+    char buffer[32];
+    const auto [end, error] = to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, end);
+}
+
+}
+
+QueryServer::QueryServer(SearchServer& search_server, uint16_t port)
+        : search_server_(search_server)
+{
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listen_fd_ < 0) {
+        ThrowSystemError("socket"s);
+    }
+    const int enable = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(listen_fd_, SOMAXCONN) < 0) {
+        const int error = errno;
+        close(listen_fd_);
+        errno = error;
+        ThrowSystemError("Cannot listen on port "s + to_string(port));
+    }
+    socklen_t address_size = sizeof(address);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &address_size);
+    port_ = ntohs(address.sin_port);
+
+    epoll_fd_ = epoll_create1(0);
+    stop_fd_ = eventfd(0, EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || stop_fd_ < 0) {
+        ThrowSystemError("epoll"s);
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+    event.data.fd = stop_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_fd_, &event);
+}
+
+QueryServer::~QueryServer() {
+    for (const auto& [fd, _] : connections_) {
+        close(fd);
+    }
+    close(stop_fd_);
+    close(epoll_fd_);
+    close(listen_fd_);
+}
+
+uint16_t QueryServer::GetPort() const {
+    return port_;
+}
+
+void QueryServer::Stop() {
+    const uint64_t one = 1;
+    [[maybe_unused]] const ssize_t written = write(stop_fd_, &one, sizeof(one));
+}
+
+void QueryServer::Run() {
+    epoll_event events[256];
+    while (true) {
+        const int event_count = epoll_wait(epoll_fd_, events, 256, -1);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait"s);
+        }
+
+        for (int i = 0; i < event_count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == stop_fd_) {
+                uint64_t value;
+                [[maybe_unused]] const ssize_t read_size = read(stop_fd_, &value, sizeof(value));
+                return;
+            }
+            if (fd == listen_fd_) {
+                Accept();
+                continue;
+            }
+            const auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                Flush(fd, it->second);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                ReadRequests(fd, it->second);
+            }
+        }
+
+        ExecuteBatch();
+
+        for (auto it = connections_.begin(); it != connections_.end();) {
+            const int fd = it->first;
+            Connection& connection = it->second;
+            ++it;
+            if (connection.output_offset < connection.output.size()) {
+                Flush(fd, connection);
+            }
+            if (connection.is_closed && connection.output_offset == connection.output.size()) {
+                Close(fd);
+            }
+        }
+    }
+}
+
+void QueryServer::Accept() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK);
+        if (fd < 0) {
+            return;
+        }
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+        Connection& connection = connections_[fd];
+        connection.output.reserve(OUTPUT_BUFFER_SIZE);
+    }
+}
+
+void QueryServer::ReadRequests(int fd, Connection& connection) {
+    char chunk[1 << 16];
+    while (true) {
+        const ssize_t result = recv(fd, chunk, sizeof(chunk), 0);
+        if (result > 0) {
+            connection.input.append(chunk, static_cast<size_t>(result));
+            continue;
+        }
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            connection.is_closed = true;
+        }
+        break;
+    }
+    if (connection.input.size() > MAX_LINE_SIZE && connection.input.find('\n') == string::npos) {
+        connection.input.clear();
+        connection.is_closed = true;
+        return;
+    }
+
+    // The views stay valid until the batch is executed, the consumed input is erased after that
+    string_view input = connection.input;
+    for (size_t line_end = input.find('\n'); line_end != string_view::npos; line_end = input.find('\n')) {
+        string_view line = input.substr(0, line_end);
+        input.remove_prefix(line_end + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        const string_view command = NextToken(line);
+        if (command.empty()) {
+            continue;
+        }
+        RequestType type = RequestType::INVALID;
+        if (command == "SEARCH"sv) {
+            type = RequestType::SEARCH;
+        }
+        else if (command == "SEARCHALL"sv) {
+            type = RequestType::SEARCH_ALL;
+        }
+        else if (command == "MATCH"sv) {
+            type = RequestType::MATCH;
+        }
+        else if (command == "ADD"sv) {
+            type = RequestType::ADD;
+        }
+        else if (command == "REMOVE"sv) {
+            type = RequestType::REMOVE;
+        }
+        batch_.push_back({ fd, type, line });
+    }
+}
+
+void QueryServer::ExecuteBatch() {
+    if (batch_.empty()) {
+        return;
+    }
+    if (responses_.size() < batch_.size()) {
+        responses_.resize(batch_.size());
+    }
+    auto is_read_only = [](const Request& request) {
+        return request.type == RequestType::SEARCH || request.type == RequestType::SEARCH_ALL || request.type == RequestType::MATCH;
+    };
+    for (size_t begin = 0; begin < batch_.size();) {
+        if (!is_read_only(batch_[begin])) {
+            Execute(batch_[begin], responses_[begin]);
+            ++begin;
+            continue;
+        }
+        const size_t end = find_if_not(batch_.begin() + begin, batch_.end(), is_read_only) - batch_.begin();
+        vector<size_t> indexes(end - begin);
+        iota(indexes.begin(), indexes.end(), begin);
+        for_each(execution::par, indexes.begin(), indexes.end(), [this](size_t index) {
+            Execute(batch_[index], responses_[index]);
+        });
+        begin = end;
+    }
+
+    for (size_t i = 0; i < batch_.size(); ++i) {
+        Connection& connection = connections_.at(batch_[i].fd);
+        connection.output += responses_[i];
+    }
+    for (auto& [fd, connection] : connections_) {
+        const size_t consumed = connection.input.rfind('\n');
+        if (consumed != string::npos) {
+            connection.input.erase(0, consumed + 1);
+        }
+    }
+    batch_.clear();
+}
+
+void QueryServer::Execute(const Request& request, string& response) {
+    response.clear();
+    try {
+        string_view arguments = request.arguments;
+        switch (request.type) {
+            case RequestType::SEARCH:
+            case RequestType::SEARCH_ALL: {
+                response += "OK"sv;
+                const QueryMode mode = request.type == RequestType::SEARCH_ALL ? QueryMode::ALL_WORDS : QueryMode::ANY_WORD;
+                for (const Document& document : search_server_.FindTopDocuments(arguments, mode)) {
+                    response += ' ';
+                    AppendNumber(response, document.id);
+                    response += ':';
+                    AppendNumber(response, document.relevance);
+                    response += ':';
+                    AppendNumber(response, document.rating);
+                }
+                break;
+            }
+            case RequestType::MATCH: {
+                const int document_id = ParseInt(NextToken(arguments));
+                const auto [words, status] = search_server_.MatchDocument(arguments, document_id);
+                response += "OK "sv;
+                response += GetStatusName(status);
+                for (const string_view word : words) {
+                    response += ' ';
+                    response += word;
+                }
+                break;
+            }
+            case RequestType::ADD: {
+                const int document_id = ParseInt(NextToken(arguments));
+                const DocumentStatus status = ParseDocumentStatus(NextToken(arguments));
+                string_view ratings_text = NextToken(arguments);
+                if (ratings_text == "-"sv) {
+                    ratings_text = {};
+                }
+                vector<int> ratings;
+                while (!ratings_text.empty()) {
+                    const size_t comma = min(ratings_text.find(','), ratings_text.size());
+                    ratings.push_back(ParseInt(ratings_text.substr(0, comma)));
+                    ratings_text.remove_prefix(min(comma + 1, ratings_text.size()));
+                }
+                search_server_.AddDocument(document_id, arguments.substr(min(arguments.find_first_not_of(' '), arguments.size())), status, ratings);
+                response += "OK"sv;
+                break;
+            }
+            case RequestType::REMOVE:
+                search_server_.RemoveDocument(ParseInt(NextToken(arguments)));
+                response += "OK"sv;
+                break;
+            case RequestType::INVALID:
+                throw invalid_argument("Unknown command"s);
+        }
+    }
+    catch (const exception& e) {
+        response.clear();
+        response += "ERR "sv;
+        response += e.what();
+    }
+    response += '\n';
+}
+
+void QueryServer::Flush(int fd, Connection& connection) {
+    while (connection.output_offset < connection.output.size()) {
+        const ssize_t result = send(fd, connection.output.data() + connection.output_offset,
+                                    connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+        if (result > 0) {
+            connection.output_offset += static_cast<size_t>(result);
+            continue;
+        }
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!connection.is_writing) {
+                epoll_event event{};
+                event.events = EPOLLIN | EPOLLOUT;
+                event.data.fd = fd;
+                epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+                connection.is_writing = true;
+            }
+            return;
+        }
+        connection.is_closed = true;
+        connection.output.clear();
+        connection.output_offset = 0;
+        return;
+    }
+    connection.output.clear();
+    connection.output_offset = 0;
+    if (connection.is_writing) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+        connection.is_writing = false;
+    }
+}
+
+void QueryServer::Close(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(fd);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "search_server.h"
+#include "document.h"
+
+// Serves a SearchServer over TCP on the loopback interface with a line protocol, one request per line:
+//   SEARCH <query>                              -> OK <id>:<relevance>:<rating> ...
+//   SEARCHALL <query>                           -> as SEARCH, with documents containing all the query words
+//   MATCH <document id> <query>                 -> OK <status> <word> ...
+//   ADD <document id> <status> <r1,r2,...> <text> -> OK
+//   REMOVE <document id>                        -> OK
+// ADD takes - for no ratings. A failed request is answered with ERR <message>.
+// Clients may pipeline requests; answers come in order.
+// Every event loop iteration executes the requests read from all connections as one batch, running
+// consecutive SEARCH, SEARCHALL and MATCH requests in parallel and applying ADD and REMOVE between them in order.
+class QueryServer {
+public:
+    // Port 0 picks a free port, see GetPort
+    QueryServer(SearchServer& search_server, uint16_t port);
+
+    QueryServer(const QueryServer&) = delete;
+
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    ~QueryServer();
+
+    uint16_t GetPort() const;
+
+    // Runs the event loop until Stop is called
+    void Run();
+
+    // May be called from any thread
+    void Stop();
+
+private:
+    struct Connection {
+        std::string input;
+        std::string output;
+        size_t output_offset = 0;
+        bool is_writing = false;
+        bool is_closed = false;
+    };
+
+    enum class RequestType {
+        SEARCH,
+        SEARCH_ALL,
+        MATCH,
+        ADD,
+        REMOVE,
+        INVALID,
+    };
+
+    struct Request {
+        int fd;
+        RequestType type;
+        std::string_view arguments;
+    };
+
+    SearchServer& search_server_;
+    int listen_fd_;
+    int epoll_fd_;
+    int stop_fd_;
+    uint16_t port_;
+    std::unordered_map<int, Connection> connections_;
+    // Reused across batches so steady-state serving does not allocate
+    std::vector<Request> batch_;
+    std::vector<std::string> responses_;
+
+    void Accept();
+
+    void ReadRequests(int fd, Connection& connection);
+
+    void ExecuteBatch();
+
+    void Execute(const Request& request, std::string& response);
+
+    void Flush(int fd, Connection& connection);
+
+    void Close(int fd);
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+// Index-wide values ranking functions depend on, taken once per query
+struct CorpusStatistics {
+    int document_count = 0;
+    double average_document_length = 0.0;
+};
+
+// Statistics of a query over a collection split into several indexes: with them every part ranks
+// its documents exactly as a single index holding the whole collection would
+struct CollectionStatistics {
+    CorpusStatistics corpus;
+    std::map<std::string, int, std::less<>> document_freqs;
+};
+
+inline CollectionStatistics MergeStatistics(const std::vector<CollectionStatistics>& parts) {
+    CollectionStatistics result;
+    double total_length = 0.0;
+    for (const CollectionStatistics& part : parts) {
+        result.corpus.document_count += part.corpus.document_count;
+        total_length += part.corpus.average_document_length * part.corpus.document_count;
+        for (const auto& [word, document_freq] : part.document_freqs) {
+            result.document_freqs[word] += document_freq;
+        }
+    }
+    if (result.corpus.document_count > 0) {
+        result.corpus.average_document_length = total_length / result.corpus.document_count;
+    }
+    return result;
+}
+
+// A ranking policy is built once per query from the corpus statistics and provides
+//   TermWeight(document_freq) - the per-term constant, computed once per query word
+//   DocumentNorm(document_length) - the per-document constant, computed once per document for given corpus
+//     statistics and kept by the server until the index changes (HAS_DOCUMENT_NORMS says whether it is used)
+//   Score(term_weight, term_freq, document_norm) - the contribution of one posting,
+// where term_freq is the share of the document's words equal to the term.
+// They are inlined into the scoring loops of BasicSearchServer, which is instantiated per policy.
+
+// Relevance is TF * log(N / df)
+struct TfIdfRanking {
+    static constexpr bool HAS_DOCUMENT_NORMS = false;
+
+    explicit TfIdfRanking(const CorpusStatistics& corpus)
+            : document_count_(corpus.document_count) {
+    }
+
+    double TermWeight(int document_freq) const {
+        return std::log(document_count_ * 1.0 / document_freq);
+    }
+
+    double DocumentNorm(int /*document_length*/) const {
+        return 0.0;
+    }
+
+    double Score(double term_weight, double term_freq, double /*document_norm*/) const {
+        return term_freq * term_weight;
+    }
+
+private:
+    int document_count_;
+};
+
+// Okapi BM25 with the usual k1 = 1.2 and b = 0.75
+struct Bm25Ranking {
+    static constexpr bool HAS_DOCUMENT_NORMS = true;
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    explicit Bm25Ranking(const CorpusStatistics& corpus)
+            : document_count_(corpus.document_count)
+            , norm_base_(K1 * (1.0 - B))
+            , norm_per_word_(corpus.average_document_length > 0.0 ? K1 * B / corpus.average_document_length : 0.0) {
+    }
+
+    double TermWeight(int document_freq) const {
+        // The +1 keeps the weight positive for terms present in most documents
+        return std::log(1.0 + (document_count_ - document_freq + 0.5) / (document_freq + 0.5));
+    }
+
+    // The length norm K1 * (1 - B + B * length / average length) divided by the length, as term_freq is
+    // the term count divided by it
+    double DocumentNorm(int document_length) const {
+        return document_length > 0 ? (norm_base_ + norm_per_word_ * document_length) / document_length : 0.0;
+    }
+
+    double Score(double term_weight, double term_freq, double document_norm) const {
+        return term_weight * term_freq * (K1 + 1.0) / (term_freq + document_norm);
+    }
+
+private:
+    int document_count_;
+    double norm_base_;
+    double norm_per_word_;
+};
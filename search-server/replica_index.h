@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "bulk_loader.h"
+#include "snapshot_index.h"
+#include "write_ahead_log.h"
+
+struct ReplicaOptions {
+    // How often the directory is checked for newly sealed log segments
+    std::chrono::milliseconds poll_interval{200};
+};
+
+// Read-only copy of an index kept up to date from the log directory of its writer, usually another process
+// with a DurableIndex over the directory. The writer ships its updates by sealing log segments (see
+// WriteAheadLogOptions::seal_interval and DurableIndex::SealLog); a background thread applies the records of
+// newly sealed segments to a new version of a SnapshotIndex and publishes it atomically, so queries read a
+// consistent version without locks and a poll costs only the documents changed since the last one.
+// A replica that falls behind a checkpoint of the writer, which removes the segments it still needs, reloads
+// the index from the checkpoint's snapshot. Any other failed poll leaves the current version as it was and is
+// counted, see GetFailedPollCount and GetLastError; the next poll retries it.
+template <typename Index>
+class ReplicaIndex {
+public:
+    using Snapshot = typename SnapshotIndex<Index>::Snapshot;
+
+    // Loads the latest snapshot and the sealed segments of the directory into a copy of the empty index
+    ReplicaIndex(Index empty_index, std::string directory, const ReplicaOptions& options = {})
+            : empty_index_(std::move(empty_index))
+            , directory_(std::move(directory))
+            , options_(options)
+            , index_(LoadInitial(), empty_index_) {
+        follower_ = std::thread([this] {
+            Follow();
+        });
+    }
+
+    ReplicaIndex(const ReplicaIndex&) = delete;
+
+    ReplicaIndex& operator=(const ReplicaIndex&) = delete;
+
+    ~ReplicaIndex() {
+        {
+            std::lock_guard guard(follow_mutex_);
+            is_stopping_ = true;
+        }
+        stop_requested_.notify_one();
+        follower_.join();
+    }
+
+    Snapshot Pin() const {
+        return index_.Pin();
+    }
+
+    // Sequence of the last log record the current version reflects
+    uint64_t GetAppliedSequence() const {
+        return applied_sequence_.load();
+    }
+
+    // Applies the segments sealed since the last poll, returns whether there were any. The background thread
+    // calls it every poll interval. Throws the error of a failed poll after counting it.
+    bool Poll() {
+        std::lock_guard guard(poll_mutex_);
+        try {
+            uint64_t sequence = applied_sequence_.load();
+            if (FindSealedSequence(directory_) <= sequence) {
+                return false;
+            }
+            if (const auto snapshot = FindLatestSnapshot(directory_); snapshot && snapshot->sequence > sequence) {
+                // A checkpoint after the applied records removes the segments holding the ones after them
+                index_.Publish(Load(sequence));
+            } else {
+                // All the new records go into one new version
+                index_.Update([this, &sequence](typename SnapshotIndex<Index>::Version& version) {
+                    sequence = ReplaySealedLog(directory_, sequence, [&version](const LogRecord& record) {
+                        ApplyLogRecord(version, record);
+                    });
+                });
+            }
+            applied_sequence_.store(sequence);
+        } catch (const std::exception& e) {
+            std::lock_guard error_guard(error_mutex_);
+            ++failed_poll_count_;
+            last_error_ = e.what();
+            throw;
+        }
+        index_.Collect();
+        return true;
+    }
+
+    // Polls that failed since the replica was created, by the background thread or by Poll
+    uint64_t GetFailedPollCount() const {
+        std::lock_guard guard(error_mutex_);
+        return failed_poll_count_;
+    }
+
+    // The error of the last failed poll, if any poll failed
+    std::optional<std::string> GetLastError() const {
+        std::lock_guard guard(error_mutex_);
+        return last_error_;
+    }
+
+private:
+    const Index empty_index_;
+    const std::string directory_;
+    const ReplicaOptions options_;
+    std::atomic<uint64_t> applied_sequence_{0};
+    SnapshotIndex<Index> index_;
+    std::mutex poll_mutex_;
+    mutable std::mutex error_mutex_;
+    uint64_t failed_poll_count_ = 0;
+    std::optional<std::string> last_error_;
+    std::mutex follow_mutex_;
+    std::condition_variable stop_requested_;
+    bool is_stopping_ = false;
+    std::thread follower_;
+
+    // Sets applied_sequence_, which is initialized before index_
+    Index LoadInitial() {
+        uint64_t sequence = 0;
+        Index index = Load(sequence);
+        applied_sequence_.store(sequence);
+        return index;
+    }
+
+    // Never modifies the directory, unlike RecoverIndex
+    Index Load(uint64_t& sequence) const {
+        Index index(empty_index_);
+        sequence = 0;
+        if (const auto snapshot = FindLatestSnapshot(directory_)) {
+            LoadCorpus(index, snapshot->path);
+            sequence = snapshot->sequence;
+        }
+        sequence = ReplaySealedLog(directory_, sequence, [&index](const LogRecord& record) {
+            ApplyLogRecord(index, record);
+        });
+        return index;
+    }
+
+    void Follow() {
+        std::unique_lock lock(follow_mutex_);
+        while (!stop_requested_.wait_for(lock, options_.poll_interval, [this] { return is_stopping_; })) {
+            lock.unlock();
+            try {
+                Poll();
+            } catch (const std::exception&) {
+                // Poll counted the failure, the next one retries it
+            }
+            lock.lock();
+        }
+    }
+};
@@ -0,0 +1,21 @@
+#include "search_facets.h"
+
+using namespace std;
+
+SearchFacets& SearchFacets::operator+=(const SearchFacets& other) {
+    for (size_t i = 0; i < DOCUMENT_STATUS_COUNT; ++i) {
+        status_counts[i] += other.status_counts[i];
+    }
+    for (size_t i = 0; i < RATING_BUCKET_COUNT; ++i) {
+        rating_counts[i] += other.rating_counts[i];
+    }
+    return *this;
+}
+
+int SearchFacets::GetStatusCount(DocumentStatus status) const {
+    return status_counts[static_cast<size_t>(status)];
+}
+
+int SearchFacets::GetRatingCount(int rating) const {
+    return rating_counts[GetRatingBucket(rating)];
+}
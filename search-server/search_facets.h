@@ -0,0 +1,40 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "document.h"
+
+// Average ratings counted in buckets of their own; lower and higher ones fall into the first and last bucket
+const int MIN_FACET_RATING = -100;
+const int MAX_FACET_RATING = 100;
+const size_t RATING_BUCKET_COUNT = MAX_FACET_RATING - MIN_FACET_RATING + 1;
+
+// Numbers of the documents matching a query by status and by rating
+struct SearchFacets {
+    std::array<int, DOCUMENT_STATUS_COUNT> status_counts = {};
+    // Number of documents by average rating, from MIN_FACET_RATING
+    std::array<int, RATING_BUCKET_COUNT> rating_counts = {};
+
+    void Add(DocumentStatus status, int rating) {
+        ++status_counts[static_cast<size_t>(status)];
+        ++rating_counts[GetRatingBucket(rating)];
+    }
+
+    // Adds the counts of facets of another part of the same search
+    SearchFacets& operator+=(const SearchFacets& other);
+
+    int GetStatusCount(DocumentStatus status) const;
+
+    // Documents with the rating, or with the ratings beyond it for the bounds of the range
+    int GetRatingCount(int rating) const;
+
+    static size_t GetRatingBucket(int rating) {
+        return static_cast<size_t>(std::clamp(rating, MIN_FACET_RATING, MAX_FACET_RATING) - MIN_FACET_RATING);
+    }
+};
+
+struct FacetedSearchResult {
+    std::vector<Document> documents;
+    SearchFacets facets;
+};
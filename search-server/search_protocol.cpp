@@ -0,0 +1,218 @@
+#include "search_protocol.h"
+#include "varint.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const size_t HEADER_SIZE = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint64_t);
+const uint32_t MAX_PAYLOAD_SIZE = 64u << 20;
+
+}
+
+void PayloadWriter::WriteByte(uint8_t value) {
+    data_.push_back(static_cast<char>(value));
+}
+
+void PayloadWriter::WriteVarint(uint64_t value) {
+    AppendVarint(data_, value);
+}
+
+void PayloadWriter::WriteSignedVarint(int64_t value) {
+    // Zigzag keeps small negative numbers short
+    AppendVarint(data_, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void PayloadWriter::WriteDouble(double value) {
+    char bytes[sizeof(double)];
+    memcpy(bytes, &value, sizeof(double));
+    data_.append(bytes, sizeof(double));
+}
+
+void PayloadWriter::WriteString(string_view value) {
+    WriteVarint(value.size());
+    data_.append(value);
+}
+
+string PayloadWriter::Release() {
+    return move(data_);
+}
+
+PayloadReader::PayloadReader(string_view payload)
+        : current_(payload.data())
+        , end_(payload.data() + payload.size())
+{
+}
+
+void PayloadReader::Require(size_t size) const {
+    if (static_cast<size_t>(end_ - current_) < size) {
+        throw runtime_error("Malformed message payload"s);
+    }
+}
+
+uint8_t PayloadReader::ReadByte() {
+    Require(1);
+    return static_cast<uint8_t>(*current_++);
+}
+
+uint64_t PayloadReader::ReadVarint() {
+    Require(1);
+    return ::ReadVarint(current_, end_);
+}
+
+int64_t PayloadReader::ReadSignedVarint() {
+    const uint64_t value = ReadVarint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+double PayloadReader::ReadDouble() {
+    Require(sizeof(double));
+    double value;
+    memcpy(&value, current_, sizeof(double));
+    current_ += sizeof(double);
+    return value;
+}
+
+string_view PayloadReader::ReadString() {
+    const size_t size = ReadVarint();
+    Require(size);
+    const string_view value(current_, size);
+    current_ += size;
+    return value;
+}
+
+void WriteStatistics(PayloadWriter& writer, const CollectionStatistics& statistics) {
+    writer.WriteVarint(statistics.corpus.document_count);
+    writer.WriteDouble(statistics.corpus.average_document_length);
+    writer.WriteVarint(statistics.document_freqs.size());
+    for (const auto& [word, document_freq] : statistics.document_freqs) {
+        writer.WriteString(word);
+        writer.WriteVarint(document_freq);
+    }
+}
+
+CollectionStatistics ReadStatistics(PayloadReader& reader) {
+    CollectionStatistics statistics;
+    statistics.corpus.document_count = static_cast<int>(reader.ReadVarint());
+    statistics.corpus.average_document_length = reader.ReadDouble();
+    for (size_t word_count = reader.ReadVarint(); word_count > 0; --word_count) {
+        const string_view word = reader.ReadString();
+        statistics.document_freqs.emplace(word, static_cast<int>(reader.ReadVarint()));
+    }
+    return statistics;
+}
+
+void WriteDocuments(PayloadWriter& writer, const vector<Document>& documents) {
+    writer.WriteVarint(documents.size());
+    for (const Document& document : documents) {
+        writer.WriteVarint(document.id);
+        writer.WriteDouble(document.relevance);
+        writer.WriteSignedVarint(document.rating);
+    }
+}
+
+vector<Document> ReadDocuments(PayloadReader& reader) {
+    // The count comes off the wire, so the vector grows only with documents actually read
+    vector<Document> documents;
+    for (size_t document_count = reader.ReadVarint(); document_count > 0; --document_count) {
+        Document& document = documents.emplace_back();
+        document.id = static_cast<int>(reader.ReadVarint());
+        document.relevance = reader.ReadDouble();
+        document.rating = static_cast<int>(reader.ReadSignedVarint());
+    }
+    return documents;
+}
+
+bool SendMessage(int fd, const Message& message) {
+    string frame(HEADER_SIZE, '\0');
+    const uint32_t payload_size = static_cast<uint32_t>(message.payload.size());
+    memcpy(frame.data(), &payload_size, sizeof(payload_size));
+    frame[sizeof(uint32_t)] = static_cast<char>(message.type);
+    memcpy(frame.data() + sizeof(uint32_t) + sizeof(uint8_t), &message.request_id, sizeof(uint64_t));
+    frame += message.payload;
+
+    for (size_t sent = 0; sent < frame.size();) {
+        const ssize_t result = send(fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+MessageStream::MessageStream(int fd)
+        : fd_(fd)
+{
+}
+
+int MessageStream::GetFd() const {
+    return fd_;
+}
+
+bool MessageStream::ReadAvailable() {
+    char chunk[1 << 16];
+    while (true) {
+        const ssize_t result = recv(fd_, chunk, sizeof(chunk), MSG_DONTWAIT);
+        if (result > 0) {
+            buffer_.append(chunk, static_cast<size_t>(result));
+            continue;
+        }
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        return result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+optional<Message> MessageStream::PopMessage() {
+    if (buffer_.size() < HEADER_SIZE) {
+        return nullopt;
+    }
+    uint32_t payload_size;
+    memcpy(&payload_size, buffer_.data(), sizeof(payload_size));
+    if (payload_size > MAX_PAYLOAD_SIZE) {
+        throw runtime_error("Message is too large"s);
+    }
+    if (buffer_.size() < HEADER_SIZE + payload_size) {
+        return nullopt;
+    }
+    Message message;
+    message.type = static_cast<MessageType>(buffer_[sizeof(uint32_t)]);
+    memcpy(&message.request_id, buffer_.data() + sizeof(uint32_t) + sizeof(uint8_t), sizeof(uint64_t));
+    message.payload = buffer_.substr(HEADER_SIZE, payload_size);
+    buffer_.erase(0, HEADER_SIZE + payload_size);
+    return message;
+}
+
+optional<Message> MessageStream::Receive(chrono::steady_clock::time_point deadline) {
+    while (true) {
+        if (auto message = PopMessage()) {
+            return message;
+        }
+        const auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            return nullopt;
+        }
+        pollfd descriptor{ fd_, POLLIN, 0 };
+        const int ready = poll(&descriptor, 1, static_cast<int>(remaining.count()));
+        if (ready < 0 && errno != EINTR) {
+            return nullopt;
+        }
+        if (ready > 0 && !ReadAvailable()) {
+            // The peer is gone, but whatever it managed to send is still a valid message
+            return PopMessage();
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "ranking.h"
+
+// Binary protocol between a search broker and shard processes. Every message is framed as
+//   u32 payload size | u8 type | u64 request id | payload
+// where integers inside payloads are varints and a reply carries the id of its request.
+
+enum class MessageType : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+    QUERY_STATISTICS = 3,
+    SEARCH = 4,
+    SHUTDOWN = 5,
+    ACK = 64,
+    STATISTICS = 65,
+    RESULTS = 66,
+    ERROR = 67,
+};
+
+struct Message {
+    MessageType type = MessageType::ACK;
+    uint64_t request_id = 0;
+    std::string payload;
+};
+
+class PayloadWriter {
+public:
+    void WriteByte(uint8_t value);
+
+    void WriteVarint(uint64_t value);
+
+    void WriteSignedVarint(int64_t value);
+
+    void WriteDouble(double value);
+
+    void WriteString(std::string_view value);
+
+    std::string Release();
+
+private:
+    std::string data_;
+};
+
+// Throws std::runtime_error when the payload ends before the value
+class PayloadReader {
+public:
+    explicit PayloadReader(std::string_view payload);
+
+    uint8_t ReadByte();
+
+    uint64_t ReadVarint();
+
+    int64_t ReadSignedVarint();
+
+    double ReadDouble();
+
+    std::string_view ReadString();
+
+private:
+    const char* current_;
+    const char* end_;
+
+    void Require(size_t size) const;
+};
+
+void WriteStatistics(PayloadWriter& writer, const CollectionStatistics& statistics);
+
+CollectionStatistics ReadStatistics(PayloadReader& reader);
+
+void WriteDocuments(PayloadWriter& writer, const std::vector<Document>& documents);
+
+std::vector<Document> ReadDocuments(PayloadReader& reader);
+
+// Writes the whole framed message to a stream socket, returns false if the peer is gone
+bool SendMessage(int fd, const Message& message);
+
+// Buffers whatever arrives on a stream socket and splits it into messages, so a reply that
+// misses its deadline is not mistaken for the beginning of the next one
+class MessageStream {
+public:
+    explicit MessageStream(int fd);
+
+    int GetFd() const;
+
+    // Reads the bytes available now, returns false once the peer has closed the connection
+    bool ReadAvailable();
+
+    std::optional<Message> PopMessage();
+
+    // Waits for a whole message until the deadline
+    std::optional<Message> Receive(std::chrono::steady_clock::time_point deadline);
+
+private:
+    int fd_;
+    std::string buffer_;
+};
@@ -2,62 +2,564 @@
 
 using  std::string_literals::operator ""s;
 
-SearchServer::SearchServer(std::string_view stop_words_text)
-        : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor
+namespace {
+
+const size_t POSTING_BYTES = TREE_NODE_OVERHEAD + sizeof(std::pair<const int, double>);
+const size_t POSITION_LIST_BYTES = TREE_NODE_OVERHEAD + sizeof(std::pair<const int, PositionList>);
+
+// A pooled word and its entries in the inverted and positional indexes
+size_t GetTermBytes(std::string_view word, bool store_positions) {
+    const size_t heap_bytes = word.size() > std::string().capacity() ? GetAllocationBytes(word.size() + 1) : 0;
+    return 3 * TREE_NODE_OVERHEAD + sizeof(std::string) + heap_bytes
+           + sizeof(std::pair<const std::string_view, std::map<int, double>>)
+           + (store_positions ? sizeof(std::pair<const std::string_view, std::map<int, PositionList>>) : 0);
+}
+
+size_t GetWordOffsetBytes(const std::vector<uint32_t>& word_offsets) {
+    return GetAllocationBytes(word_offsets.capacity() * sizeof(uint32_t));
+}
+
+}
+
+template <typename RankingPolicy>
+BasicSearchServer<RankingPolicy>::BasicSearchServer(std::string_view stop_words_text, const IndexOptions& options)
+        : BasicSearchServer(SplitIntoWords(stop_words_text), options)  // Invoke delegating constructor
 // from string container
 {
 }
-SearchServer::SearchServer(std::string stop_words_text)
-        : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor
+template <typename RankingPolicy>
+BasicSearchServer<RankingPolicy>::BasicSearchServer(std::string stop_words_text, const IndexOptions& options)
+        : BasicSearchServer(SplitIntoWords(stop_words_text), options)  // Invoke delegating constructor
 // from string container
 {
 }
 
-void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+template <typename RankingPolicy>
+BasicSearchServer<RankingPolicy>::BasicSearchServer(const BasicSearchServer& other)
+        : stop_words_(other.stop_words_)
+        , word_pool_(other.word_pool_)
+        , term_dictionary_(other.term_dictionary_)
+        , term_filter_(other.term_filter_)
+        , impacts_(other.impacts_)
+        , documents_(other.documents_)
+        , document_attributes_(other.document_attributes_)
+        , document_ids_(other.document_ids_)
+        , total_document_length_(other.total_document_length_)
+        , document_store_(other.document_store_)
+        , top_documents_cache_(std::make_unique<TopDocumentsCache>())
+        , document_norms_(std::make_unique<DocumentNormsCache>())
+        , lexicon_bytes_(other.lexicon_bytes_)
+        , posting_count_(other.posting_count_)
+        , position_bytes_(other.position_bytes_)
+        , unused_term_count_(other.unused_term_count_)
+        , options_(other.options_)
+{
+    const auto pooled = [this](std::string_view word) {
+        return std::string_view(*word_pool_.find(word));
+    };
+    for (const auto& [word, document_freqs] : other.word_to_document_freqs_) {
+        word_to_document_freqs_.emplace_hint(word_to_document_freqs_.end(), pooled(word), document_freqs);
+    }
+    for (auto& [document_id, document_data] : documents_) {
+        for (ForwardIndexEntry& entry : document_data.words) {
+            const auto it = word_to_document_freqs_.find(entry.word);
+            entry = { it->first, &it->second.at(document_id) };
+        }
+    }
+    for (const auto& [word, document_positions] : other.word_to_document_positions_) {
+        word_to_document_positions_.emplace_hint(word_to_document_positions_.end(), pooled(word), document_positions);
+    }
+}
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
     if ((document_id < 0) || (documents_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id"s);
     }
-    const auto words = SplitIntoWordsNoStop(document.data());
+    const auto words = SplitIntoWordsNoStop(document);
+    impacts_ = std::monostate();
+    top_documents_cache_->Invalidate();
+    document_norms_->Invalidate();
 
     const double inv_word_count = 1.0 / words.size();
+    std::map<std::string_view, double> word_freqs;
     for (const std::string& word : words) {
-        documents_[document_id].words.insert(word);
-        documents_words_with_freq_[document_id][*documents_[document_id].words.find(word)] += inv_word_count;
-        word_to_document_freqs_[*documents_[document_id].words.find(word)][document_id] += inv_word_count;
+        word_freqs[word] += inv_word_count;
+    }
+    ReserveMemory(EstimateDocumentBytes(word_freqs, words.size(), document));
+
+    DocumentData& document_data = documents_[document_id];
+    auto& document_words = document_data.words;
+    document_words.reserve(word_freqs.size());
+    for (const auto& [word, freq] : word_freqs) {
+        auto pooled_it = word_pool_.find(word);
+        const bool is_new_term = pooled_it == word_pool_.end();
+        if (is_new_term) {
+            term_dictionary_.Insert(word);
+            // Index keys view the pooled copy, which outlives every document containing the word
+            pooled_it = word_pool_.emplace(word).first;
+            AddToTermFilter(*pooled_it);
+            lexicon_bytes_ += GetTermBytes(word, options_.store_positions);
+        }
+        auto& postings = word_to_document_freqs_[*pooled_it];
+        if (!is_new_term && postings.empty()) {
+            --unused_term_count_;
+        }
+        double& posting_freq = postings[document_id];
+        posting_freq = freq;
+        document_words.push_back({ *pooled_it, &posting_freq });
+    }
+    posting_count_ += word_freqs.size();
+    if (options_.store_positions) {
+        // Positions count stop words too, so phrases keep their original spacing
+        std::map<std::string_view, std::vector<uint32_t>> word_positions;
+        uint32_t position = 0;
+        for (const std::string_view word : SplitIntoWords(document)) {
+            if (!IsStopWord(word)) {
+                word_positions[word].push_back(position);
+            }
+            if (options_.store_documents && position % WORD_OFFSET_INTERVAL == 0) {
+                document_data.word_offsets.push_back(static_cast<uint32_t>(word.data() - document.data()));
+            }
+            ++position;
+        }
+        document_data.word_offsets.shrink_to_fit();
+        position_bytes_ += GetWordOffsetBytes(document_data.word_offsets);
+        for (const auto& [word, positions] : word_positions) {
+            PositionList& list = word_to_document_positions_[word_to_document_freqs_.find(word)->first][document_id];
+            list = PositionList(positions);
+            position_bytes_ += POSITION_LIST_BYTES + GetAllocationBytes(list.ByteSize());
+        }
     }
-    documents_[document_id].rating = ComputeAverageRating(ratings);
-    documents_[document_id].status = status;
+    document_attributes_.Add(document_id, status, ComputeAverageRating(ratings), static_cast<int>(words.size()));
+    total_document_length_ += static_cast<int>(words.size());
     document_ids_.insert(document_id);
+    if (options_.store_documents) {
+        document_store_.Add(document_id, document, ratings);
+    }
+    if (options_.soft_memory_limit != 0 && GetMemoryUsage().Total() > options_.soft_memory_limit) {
+        CompactOverSoftLimit();
+    }
 }
 
 
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+template <typename RankingPolicy>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    if (auto documents = FindHotTermTopDocuments(raw_query, status)) {
+        return std::move(*documents);
+    }
     return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
         return document_status == status;
     });
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
+template <typename RankingPolicy>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(std::string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
-int SearchServer::GetDocumentCount() const {
+template <typename RankingPolicy>
+std::optional<std::vector<Document>> BasicSearchServer<RankingPolicy>::FindHotTermTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    if (options_.hot_term_document_count == 0 || !std::holds_alternative<std::monostate>(impacts_)) {
+        return std::nullopt;
+    }
+    const auto words = SplitIntoWords(raw_query);
+    if (words.size() != 1) {
+        return std::nullopt;
+    }
+    const auto query_word = ParseQueryWord(words.front());
+    if (query_word.is_minus || query_word.is_stop || query_word.is_prefix || query_word.is_fuzzy) {
+        return std::nullopt;
+    }
+    const auto word_it = word_to_document_freqs_.find(query_word.data);
+    if (word_it == word_to_document_freqs_.end() || word_it->second.size() < options_.hot_term_document_count) {
+        return std::nullopt;
+    }
+
+    auto entry = top_documents_cache_->Find(word_it->first);
+    if (entry == nullptr) {
+        // Ranked exactly as FindAllDocuments and FindTopDocuments rank a single word, for every status at once
+        const auto& postings = word_it->second;
+        const CorpusStatistics corpus = GetCorpusStatistics();
+        const RankingPolicy ranking(corpus);
+        const auto norms = GetDocumentNorms(corpus);
+        const double term_weight = ranking.TermWeight(postings.size());
+        auto new_entry = std::make_shared<TopDocumentsCache::Entry>();
+        DocumentAttributes::Cursor document(document_attributes_);
+        for (const auto [document_id, term_freq] : postings) {
+            document.Seek(document_id);
+            (*new_entry)[static_cast<size_t>(document.GetStatus())].emplace_back(document_id, ranking.Score(term_weight, term_freq, GetDocumentNorm(*norms, document)), document.GetRating());
+        }
+        for (std::vector<Document>& documents : *new_entry) {
+            std::sort(documents.begin(), documents.end(), IsRankedBefore);
+            if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+                documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+            }
+            documents.shrink_to_fit();
+        }
+        top_documents_cache_->Insert(word_it->first, new_entry);
+        entry = std::move(new_entry);
+    }
+    return (*entry)[static_cast<size_t>(status)];
+}
+
+template <typename RankingPolicy>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(std::string_view raw_query, QueryMode mode, DocumentStatus status) const {
+    if (mode == QueryMode::ANY_WORD) {
+        return FindTopDocuments(raw_query, status);
+    }
+    return FindTopDocuments(raw_query, mode, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+template <typename RankingPolicy>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(std::string_view raw_query, QueryMode mode) const {
+    return FindTopDocuments(raw_query, mode, DocumentStatus::ACTUAL);
+}
+
+template <typename RankingPolicy>
+SearchPage BasicSearchServer<RankingPolicy>::FindTopDocumentsAfter(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& after, DocumentStatus status) const {
+    return FindTopDocumentsAfter(raw_query, page_size, after, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+template <typename RankingPolicy>
+SearchPage BasicSearchServer<RankingPolicy>::FindTopDocumentsAfter(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& after) const {
+    return FindTopDocumentsAfter(raw_query, page_size, after, DocumentStatus::ACTUAL);
+}
+
+template <typename RankingPolicy>
+int BasicSearchServer<RankingPolicy>::GetDocumentCount() const {
     return documents_.size();
 }
 
-bool SearchServer::IsStopWord(std::string_view word) const {
+template <typename RankingPolicy>
+MemoryUsage BasicSearchServer<RankingPolicy>::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.lexicon = lexicon_bytes_ + term_dictionary_.ByteSize() + term_filter_.ByteSize();
+    usage.postings = posting_count_ * POSTING_BYTES + position_bytes_;
+    std::visit([&usage](const auto& impacts) {
+        if constexpr (!std::is_same_v<std::decay_t<decltype(impacts)>, std::monostate>) {
+            usage.postings += impacts.ByteSize();
+        }
+    }, impacts_);
+    usage.forward_index = posting_count_ * sizeof(ForwardIndexEntry);
+    usage.document_metadata = documents_.size() * (2 * TREE_NODE_OVERHEAD + sizeof(std::pair<const int, DocumentData>) + sizeof(int))
+                              + document_attributes_.ByteSize();
+    usage.document_store = document_store_.ByteSize();
+    usage.caches = document_store_.GetCacheByteSize() + top_documents_cache_->ByteSize() + document_norms_->ByteSize();
+    return usage;
+}
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::Compact() {
+    document_store_.ClearCache();
+    document_store_.Compact();
+    RemoveUnusedTerms();
+}
+
+template <typename RankingPolicy>
+size_t BasicSearchServer<RankingPolicy>::EstimateDocumentBytes(const std::map<std::string_view, double>& word_freqs, size_t word_count, std::string_view document) const {
+    size_t bytes = 2 * TREE_NODE_OVERHEAD + sizeof(std::pair<const int, DocumentData>) + sizeof(int)
+                   + sizeof(int) + sizeof(DocumentStatus) + 2 * sizeof(int) + word_freqs.size() * (POSTING_BYTES + sizeof(ForwardIndexEntry));
+    for (const auto& [word, _] : word_freqs) {
+        if (word_pool_.count(word) == 0) {
+            bytes += GetTermBytes(word, options_.store_positions);
+        }
+    }
+    if (options_.store_positions) {
+        // At least a byte per position
+        bytes += word_freqs.size() * (POSITION_LIST_BYTES + GetAllocationBytes(1)) + word_count;
+        if (options_.store_documents) {
+            bytes += GetAllocationBytes((word_count / WORD_OFFSET_INTERVAL + 1) * sizeof(uint32_t));
+        }
+    }
+    if (options_.store_documents) {
+        // Uncompressed until its block is sealed
+        bytes += document.size();
+    }
+    return bytes;
+}
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::ReserveMemory(size_t bytes) {
+    if (options_.hard_memory_limit == 0 || GetMemoryUsage().Total() + bytes <= options_.hard_memory_limit) {
+        return;
+    }
+    Compact();
+    if (const size_t total = GetMemoryUsage().Total(); total + bytes > options_.hard_memory_limit) {
+        throw std::length_error("Memory limit exceeded: index takes "s + std::to_string(total) + " bytes, document needs "s
+                                + std::to_string(bytes) + ", limit is "s + std::to_string(options_.hard_memory_limit));
+    }
+}
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::CompactOverSoftLimit() {
+    // A compaction rewrites its whole structure, so it waits until an eighth of it is garbage
+    const size_t WASTE_FRACTION = 8;
+    document_store_.ClearCache();
+    top_documents_cache_->Invalidate();
+    document_norms_->Invalidate();
+    if (document_store_.GetGarbageByteSize() * WASTE_FRACTION >= document_store_.ByteSize()) {
+        document_store_.Compact();
+    }
+    if (unused_term_count_ * WASTE_FRACTION >= word_pool_.size()) {
+        RemoveUnusedTerms();
+    }
+}
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::RemoveUnusedTerms() {
+    if (unused_term_count_ == 0) {
+        return;
+    }
+    for (auto it = word_to_document_freqs_.begin(); it != word_to_document_freqs_.end();) {
+        if (!it->second.empty()) {
+            ++it;
+            continue;
+        }
+        // Every key viewing the pooled word goes before the word itself
+        const auto pooled_it = word_pool_.find(it->first);
+        word_to_document_positions_.erase(it->first);
+        lexicon_bytes_ -= GetTermBytes(it->first, options_.store_positions);
+        it = word_to_document_freqs_.erase(it);
+        word_pool_.erase(pooled_it);
+    }
+    TermDictionary term_dictionary;
+    for (const auto& [word, _] : word_to_document_freqs_) {
+        term_dictionary.Insert(word);
+    }
+    term_dictionary_ = std::move(term_dictionary);
+    BloomFilter term_filter(word_pool_.size());
+    for (const std::string& word : word_pool_) {
+        term_filter.Add(word);
+    }
+    term_filter_ = std::move(term_filter);
+    unused_term_count_ = 0;
+}
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::AddToTermFilter(std::string_view word) {
+    if (term_filter_.size() < term_filter_.GetCapacity()) {
+        term_filter_.Add(word);
+        return;
+    }
+    // Doubling keeps the rebuilds amortized constant per word
+    const size_t MIN_CAPACITY = 1024;
+    BloomFilter term_filter(std::max(MIN_CAPACITY, 2 * term_filter_.GetCapacity()));
+    for (const std::string& pooled_word : word_pool_) {
+        term_filter.Add(pooled_word);
+    }
+    term_filter_ = std::move(term_filter);
+}
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::DropAbsentWords(Query& query) const {
+    const auto is_absent = [this](std::string_view word) {
+        return !term_filter_.MayContain(word);
+    };
+    const auto has_absent_word = [&is_absent](const Phrase& phrase) {
+        return std::any_of(phrase.begin(), phrase.end(), [&is_absent](const PhraseWord& word) {
+            return is_absent(word.data);
+        });
+    };
+    query.plus_words.erase(std::remove_if(query.plus_words.begin(), query.plus_words.end(), is_absent), query.plus_words.end());
+    query.minus_words.erase(std::remove_if(query.minus_words.begin(), query.minus_words.end(), is_absent), query.minus_words.end());
+    query.plus_phrases.erase(std::remove_if(query.plus_phrases.begin(), query.plus_phrases.end(), has_absent_word), query.plus_phrases.end());
+    for (auto& terms : query.required_terms) {
+        terms.erase(std::remove_if(terms.begin(), terms.end(), is_absent), terms.end());
+    }
+    query.minus_phrases.erase(std::remove_if(query.minus_phrases.begin(), query.minus_phrases.end(), has_absent_word), query.minus_phrases.end());
+}
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::SealImpacts(ImpactPrecision precision) {
+    SealImpacts(precision, DocumentOrder::BY_ID);
+}
+
+template <typename RankingPolicy>
+ReorderingReport BasicSearchServer<RankingPolicy>::SealImpacts(ImpactPrecision precision, DocumentOrder order) {
+    const std::vector<int> sorted_ids(document_ids_.begin(), document_ids_.end());
+    const CorpusStatistics corpus = GetCorpusStatistics();
+    const RankingPolicy ranking(corpus);
+    const auto norms = GetDocumentNorms(corpus);
+
+    // Forward index by term number and by index in sorted_ids, the input of the reordering
+    std::vector<std::vector<uint32_t>> document_terms(sorted_ids.size());
+    uint32_t term_count = 0;
+    double max_impact = 0.0;
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        if (postings.empty()) {
+            continue;
+        }
+        const double term_weight = ranking.TermWeight(postings.size());
+        auto id_it = sorted_ids.begin();
+        DocumentAttributes::Cursor document(document_attributes_);
+        for (const auto [document_id, term_freq] : postings) {
+            id_it = std::lower_bound(id_it, sorted_ids.end(), document_id);
+            document_terms[id_it - sorted_ids.begin()].push_back(term_count);
+            document.Seek(document_id);
+            max_impact = std::max(max_impact, ranking.Score(term_weight, term_freq, GetDocumentNorm(*norms, document)));
+        }
+        ++term_count;
+    }
+
+    std::vector<uint32_t> id_order(sorted_ids.size());
+    std::iota(id_order.begin(), id_order.end(), 0);
+    const std::vector<uint32_t> new_order = order == DocumentOrder::CLUSTERED ? ComputeClusteredOrder(document_terms, term_count) : id_order;
+    ReorderingReport report;
+    report.id_order = MeasureOrdinalGaps(document_terms, term_count, id_order);
+    report.new_order = MeasureOrdinalGaps(document_terms, term_count, new_order);
+    document_terms.clear();
+    document_terms.shrink_to_fit();
+
+    // The external ids stay as they are, only the ordinals of the impact index follow the new order
+    std::vector<int> document_ids(sorted_ids.size());
+    std::vector<uint32_t> ordinals(sorted_ids.size());
+    for (uint32_t ordinal = 0; ordinal < new_order.size(); ++ordinal) {
+        document_ids[ordinal] = sorted_ids[new_order[ordinal]];
+        ordinals[new_order[ordinal]] = ordinal;
+    }
+
+    auto build = [&](auto impacts) {
+        std::vector<std::pair<uint32_t, double>> term_postings;
+        for (const auto& [word, postings] : word_to_document_freqs_) {
+            if (postings.empty()) {
+                continue;
+            }
+            const double term_weight = ranking.TermWeight(postings.size());
+            term_postings.clear();
+            auto id_it = sorted_ids.begin();
+            DocumentAttributes::Cursor document(document_attributes_);
+            for (const auto [document_id, term_freq] : postings) {
+                id_it = std::lower_bound(id_it, sorted_ids.end(), document_id);
+                document.Seek(document_id);
+                term_postings.emplace_back(ordinals[id_it - sorted_ids.begin()], ranking.Score(term_weight, term_freq, GetDocumentNorm(*norms, document)));
+            }
+            if (order != DocumentOrder::BY_ID) {
+                std::sort(term_postings.begin(), term_postings.end());
+            }
+            impacts.AddTerm(word, term_postings);
+        }
+        impacts_ = std::move(impacts);
+    };
+    top_documents_cache_->Invalidate();
+    if (precision == ImpactPrecision::BITS_8) {
+        build(ImpactIndex<uint8_t>(std::move(document_ids), max_impact));
+    }
+    else {
+        build(ImpactIndex<uint16_t>(std::move(document_ids), max_impact));
+    }
+    return report;
+}
+
+template <typename RankingPolicy>
+bool BasicSearchServer<RankingPolicy>::CanUseImpacts(const Query& query) const {
+    return !std::holds_alternative<std::monostate>(impacts_) && query.plus_phrases.empty() && query.minus_phrases.empty()
+           && query.fuzzy_words.empty();
+}
+
+template <typename RankingPolicy>
+std::vector<std::pair<int, double>> BasicSearchServer<RankingPolicy>::ScoreDocumentsByImpacts(const Query& query) const {
+    return std::visit([&query](const auto& impacts) {
+        std::vector<std::pair<int, double>> scored_documents;
+        if constexpr (!std::is_same_v<std::decay_t<decltype(impacts)>, std::monostate>) {
+            std::vector<uint32_t> scores(impacts.GetDocumentCount());
+            for (const std::string_view word : query.plus_words) {
+                impacts.Accumulate(word, scores);
+            }
+            for (const std::string_view word : query.minus_words) {
+                impacts.Exclude(word, scores);
+            }
+            for (uint32_t ordinal = 0; ordinal < scores.size(); ++ordinal) {
+                if (scores[ordinal] != 0) {
+                    scored_documents.emplace_back(impacts.GetDocumentId(ordinal), impacts.Dequantize(scores[ordinal]));
+                }
+            }
+            // Clustered ordinals do not follow ids
+            if (!std::is_sorted(scored_documents.begin(), scored_documents.end())) {
+                std::sort(scored_documents.begin(), scored_documents.end());
+            }
+        }
+        return scored_documents;
+    }, impacts_);
+}
+
+template <typename RankingPolicy>
+std::shared_ptr<const DocumentNorms> BasicSearchServer<RankingPolicy>::GetDocumentNorms(const CorpusStatistics& corpus) const {
+    if constexpr (!RankingPolicy::HAS_DOCUMENT_NORMS) {
+        static const auto empty_norms = std::make_shared<const DocumentNorms>();
+        return empty_norms;
+    } else {
+        const RankingPolicy ranking(corpus);
+        return document_norms_->Get(document_attributes_, corpus.average_document_length, [&ranking](int document_length) {
+            return ranking.DocumentNorm(document_length);
+        });
+    }
+}
+
+template <typename RankingPolicy>
+CorpusStatistics BasicSearchServer<RankingPolicy>::GetCorpusStatistics() const {
+    const int document_count = GetDocumentCount();
+    return { document_count, document_count == 0 ? 0.0 : total_document_length_ * 1.0 / document_count };
+}
+
+template <typename RankingPolicy>
+CollectionStatistics BasicSearchServer<RankingPolicy>::GetQueryStatistics(std::string_view raw_query) const {
+    const auto query = ParseQuery(std::execution::seq, raw_query);
+    CollectionStatistics statistics{ GetCorpusStatistics(), {} };
+    auto add_word = [&](std::string_view word) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+            statistics.document_freqs.emplace(word, it->second.size());
+        }
+    };
+    for (const std::string_view word : query.plus_words) {
+        add_word(word);
+    }
+    // The required terms hold the words of every plus phrase, also of the phrases dropped for a word this index
+    // lacks, which another part of the collection may still match
+    for (const auto& terms : query.required_terms) {
+        for (const std::string_view term : terms) {
+            add_word(term);
+        }
+    }
+    for (const FuzzyWord& fuzzy_word : query.fuzzy_words) {
+        for (const FuzzyTerm& term : fuzzy_word) {
+            add_word(term.data);
+        }
+    }
+    return statistics;
+}
+
+template <typename RankingPolicy>
+int BasicSearchServer<RankingPolicy>::GetDocumentFreq(std::string_view word, const CollectionStatistics* collection) const {
+    if (collection != nullptr) {
+        if (const auto it = collection->document_freqs.find(word); it != collection->document_freqs.end()) {
+            return it->second;
+        }
+    }
+    return word_to_document_freqs_.at(word).size();
+}
+
+template <typename RankingPolicy>
+bool BasicSearchServer<RankingPolicy>::IsStopWord(std::string_view word) const {
     return stop_words_.count(word) > 0;
 }
 
-bool SearchServer::IsValidWord(std::string_view word) {
+template <typename RankingPolicy>
+bool BasicSearchServer<RankingPolicy>::IsValidWord(std::string_view word) {
     // A valid word must not contain special characters
     return std::none_of(word.begin(), word.end(), [](char c) {
         return c >= '\0' && c < ' ';
     });
 }
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string& text) const {
+template <typename RankingPolicy>
+std::vector<std::string> BasicSearchServer<RankingPolicy>::SplitIntoWordsNoStop(std::string_view text) const {
     std::vector<std::string> words;
     for (std::string_view word : SplitIntoWords(text)) {
         if (!IsValidWord(word)) {
@@ -70,14 +572,16 @@ std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string& t
     return words;
 }
 
-int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
+template <typename RankingPolicy>
+int BasicSearchServer<RankingPolicy>::ComputeAverageRating(const std::vector<int>& ratings) {
     if (ratings.empty()) {
         return 0;
     }
     return std::accumulate(ratings.begin(), ratings.end(), 0) / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
+template <typename RankingPolicy>
+typename BasicSearchServer<RankingPolicy>::QueryWord BasicSearchServer<RankingPolicy>::ParseQueryWord(std::string_view text) const {
     if (text.empty()) {
         throw std::invalid_argument("Query word is empty"s);
     }
@@ -86,143 +590,819 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
         is_minus = true;
         text = text.substr(1);
     }
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
-        throw std::invalid_argument("Query word "s + text.data() + " is invalid");
+    bool is_fuzzy = false;
+    if (!text.empty() && text[0] == '~') {
+        is_fuzzy = true;
+        text = text.substr(1);
+    }
+    bool is_prefix = false;
+    if (text.size() > 1 && text.back() == '*') {
+        is_prefix = true;
+        text.remove_suffix(1);
+    }
+    if (text.empty() || text[0] == '-' || text[0] == '~' || (is_fuzzy && is_prefix) || !IsValidWord(text)) {
+        throw std::invalid_argument("Query word "s + std::string(text) + " is invalid"s);
     }
 
-    return { text, is_minus, IsStopWord(text) };
+    return { text, is_minus, !is_prefix && !is_fuzzy && IsStopWord(text), is_prefix, is_fuzzy };
 }
 
+template <typename RankingPolicy>
+bool BasicSearchServer<RankingPolicy>::IsRankedBefore(const Document& lhs, const Document& rhs) {
+    // Relevances are rounded down once rather than compared within a tolerance, which would not be transitive
+    const double error = 1e-6;
+    const double lhs_relevance = std::floor(lhs.relevance / error);
+    const double rhs_relevance = std::floor(rhs.relevance / error);
+    if (lhs_relevance != rhs_relevance) {
+        return lhs_relevance > rhs_relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
 
-SearchServer::Query SearchServer::ParseQuery(const std::execution::parallel_policy& policy, std::string_view text) const {
+template <typename RankingPolicy>
+SearchPage BasicSearchServer<RankingPolicy>::SelectPage(std::vector<Document> matched_documents, size_t page_size, const std::optional<SearchCursor>& after) {
+    // Max-heap by ranking order: its top is the worst document of the page collected so far
+    std::vector<Document> page;
+    page.reserve(std::min(page_size, matched_documents.size()));
+    size_t candidate_count = 0;
+    for (Document& document : matched_documents) {
+        if (after && !IsRankedBefore({ after->id, after->relevance, after->rating }, document)) {
+            continue;
+        }
+        ++candidate_count;
+        if (page.size() < page_size) {
+            page.push_back(std::move(document));
+            std::push_heap(page.begin(), page.end(), IsRankedBefore);
+        }
+        else if (IsRankedBefore(document, page.front())) {
+            std::pop_heap(page.begin(), page.end(), IsRankedBefore);
+            page.back() = std::move(document);
+            std::push_heap(page.begin(), page.end(), IsRankedBefore);
+        }
+    }
+    std::sort_heap(page.begin(), page.end(), IsRankedBefore);
+
+    SearchPage result;
+    if (candidate_count > page.size()) {
+        result.next = SearchCursor{ page.back().relevance, page.back().rating, page.back().id };
+    }
+    result.documents = std::move(page);
+    return result;
+}
+
+template <typename RankingPolicy>
+typename BasicSearchServer<RankingPolicy>::Query BasicSearchServer<RankingPolicy>::ParseQuery(const std::execution::parallel_policy& policy, std::string_view text) const {
     Query result;
-    for (const std::string_view word : SplitIntoWords(text)) {
+    Phrase phrase;
+    bool in_phrase = false;
+    bool is_minus_phrase = false;
+    uint32_t phrase_offset = 0;
+    for (std::string_view word : SplitIntoWords(text)) {
+        if (!in_phrase) {
+            if (word[0] != '"' && (word.size() < 2 || word[0] != '-' || word[1] != '"')) {
+                const auto query_word = ParseQueryWord(word);
+                if (query_word.is_prefix) {
+                    auto& words = query_word.is_minus ? result.minus_words : result.plus_words;
+                    auto terms = ExpandPrefix(query_word.data);
+                    words.insert(words.end(), terms.begin(), terms.end());
+                    if (!query_word.is_minus) {
+                        result.required_terms.push_back(std::move(terms));
+                    }
+                }
+                else if (query_word.is_fuzzy) {
+                    FuzzyWord terms = ExpandFuzzy(query_word.data);
+                    if (query_word.is_minus) {
+                        for (const FuzzyTerm& term : terms) {
+                            result.minus_words.push_back(term.data);
+                        }
+                    }
+                    else {
+                        std::vector<std::string_view>& required_terms = result.required_terms.emplace_back();
+                        for (const FuzzyTerm& term : terms) {
+                            required_terms.push_back(term.data);
+                        }
+                        if (!terms.empty()) {
+                            result.fuzzy_words.push_back(std::move(terms));
+                        }
+                    }
+                }
+                else if (!query_word.is_stop) {
+                    if (query_word.is_minus) {
+                        result.minus_words.push_back(query_word);
+                    }
+                    else {
+                        result.plus_words.push_back(query_word);
+                        result.required_terms.push_back({ query_word.data });
+                    }
+                }
+                continue;
+            }
+            in_phrase = true;
+            is_minus_phrase = word[0] == '-';
+            word.remove_prefix(is_minus_phrase ? 2 : 1);
+            phrase.clear();
+            phrase_offset = 0;
+        }
+
+        const bool is_phrase_end = !word.empty() && word.back() == '"';
+        if (is_phrase_end) {
+            word.remove_suffix(1);
+        }
         const auto query_word = ParseQueryWord(word);
+        if (query_word.is_minus || query_word.is_prefix || query_word.is_fuzzy) {
+            throw std::invalid_argument("Phrase word "s + std::string(word) + " is invalid"s);
+        }
         if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word);
+            phrase.push_back({ query_word.data, phrase_offset });
+        }
+        ++phrase_offset;
+
+        if (is_phrase_end) {
+            in_phrase = false;
+            AddPhrase(result, std::move(phrase), is_minus_phrase);
+        }
+    }
+    if (in_phrase) {
+        throw std::invalid_argument("Query phrase is not closed"s);
+    }
+    DropAbsentWords(result);
+
+    return result;
+}
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::AddPhrase(Query& query, Phrase phrase, bool is_minus) const {
+    if (phrase.empty()) {
+        return;
+    }
+    if (!is_minus) {
+        for (const PhraseWord& word : phrase) {
+            query.required_terms.push_back({ word.data });
+        }
+    }
+    if (phrase.size() == 1) {
+        (is_minus ? query.minus_words : query.plus_words).push_back(phrase.front().data);
+        return;
+    }
+    if (!options_.store_positions) {
+        throw std::invalid_argument("Phrase queries require an index with positions"s);
+    }
+    const uint32_t first_offset = phrase.front().offset;
+    for (PhraseWord& word : phrase) {
+        word.offset -= first_offset;
+    }
+    (is_minus ? query.minus_phrases : query.plus_phrases).push_back(std::move(phrase));
+}
+
+template <typename RankingPolicy>
+typename BasicSearchServer<RankingPolicy>::FuzzyWord BasicSearchServer<RankingPolicy>::ExpandFuzzy(std::string_view word) const {
+    const LevenshteinAutomaton automaton(word, word.size() <= SHORT_FUZZY_WORD_LENGTH ? 1 : MAX_FUZZY_DISTANCE);
+    // Distance, minus the document count and the term, so that the best terms come first
+    std::vector<std::tuple<int, int, std::string_view>> terms;
+    // states[i] is the state after the first i characters of previous_term
+    std::vector<LevenshteinAutomaton::State> states = { automaton.Start() };
+    std::string previous_term;
+    std::array<bool, 256> in_word{};
+    for (const char c : word) {
+        in_word[static_cast<unsigned char>(c)] = true;
+    }
+    TermDictionary::Cursor cursor(term_dictionary_);
+    while (!cursor.AtEnd()) {
+        const std::string_view term = cursor.Value();
+        const size_t shared_size = std::mismatch(previous_term.begin(), previous_term.end(), term.begin(), term.end()).first - previous_term.begin();
+        states.resize(shared_size + 1);
+        size_t length = shared_size;
+        for (; length < term.size(); ++length) {
+            LevenshteinAutomaton::State state = automaton.Step(states.back(), term[length]);
+            if (!automaton.CanMatch(state)) {
+                break;
+            }
+            states.push_back(std::move(state));
+        }
+
+        if (length == term.size()) {
+            if (automaton.IsMatch(states.back())) {
+                const auto it = word_to_document_freqs_.find(term);
+                if (!it->second.empty()) {
+                    terms.emplace_back(automaton.GetDistance(states.back()), -static_cast<int>(it->second.size()), it->first);
+                }
             }
-            else {
-                result.plus_words.push_back(query_word);
+            previous_term = term;
+            cursor.Next();
+            continue;
+        }
+
+        // No term starting with the first length + 1 characters matches: seek to the smallest greater prefix
+        // the automaton can still extend to a match, trying only the characters of the word and one other
+        std::string next_prefix(term.substr(0, length + 1));
+        while (!next_prefix.empty()) {
+            const size_t position = next_prefix.size() - 1;
+            int next_char = static_cast<unsigned char>(next_prefix.back()) + 1;
+            // Every character outside the word steps to the same state, so only the first of them is tried
+            bool other_tried = false;
+            for (; next_char < 256; ++next_char) {
+                if (!in_word[next_char]) {
+                    if (other_tried) {
+                        continue;
+                    }
+                    other_tried = true;
+                }
+                if (automaton.CanMatch(automaton.Step(states[position], static_cast<char>(next_char)))) {
+                    break;
+                }
             }
+            if (next_char < 256) {
+                next_prefix.back() = static_cast<char>(next_char);
+                break;
+            }
+            next_prefix.pop_back();
+        }
+        if (next_prefix.empty()) {
+            break;
         }
+        previous_term = next_prefix.substr(0, next_prefix.size() - 1);
+        states.resize(next_prefix.size());
+        cursor.Seek(next_prefix);
     }
 
+    if (terms.size() > MAX_FUZZY_EXPANSION_COUNT) {
+        std::nth_element(terms.begin(), terms.begin() + MAX_FUZZY_EXPANSION_COUNT, terms.end());
+        terms.resize(MAX_FUZZY_EXPANSION_COUNT);
+    }
+    FuzzyWord result;
+    result.reserve(terms.size());
+    for (const auto& [distance, _, term] : terms) {
+        result.push_back({ term, std::pow(FUZZY_EDIT_PENALTY, distance) });
+    }
     return result;
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::execution::sequenced_policy&, std::string_view text) const {
+template <typename RankingPolicy>
+typename BasicSearchServer<RankingPolicy>::Query BasicSearchServer<RankingPolicy>::ParseQuery(const std::execution::sequenced_policy&, std::string_view text) const {
     Query result = ParseQuery(std::execution::par, text);
     std::sort(result.plus_words.begin(), result.plus_words.end(), std::less<>());
     result.plus_words.erase(std::unique(result.plus_words.begin(), result.plus_words.end()), result.plus_words.end());
     std::sort(result.minus_words.begin(), result.minus_words.end(), std::less<>());
     result.minus_words.erase(std::unique(result.minus_words.begin(), result.minus_words.end()), result.minus_words.end());
+    for (auto& terms : result.required_terms) {
+        std::sort(terms.begin(), terms.end(), std::less<>());
+    }
+    std::sort(result.required_terms.begin(), result.required_terms.end());
+    result.required_terms.erase(std::unique(result.required_terms.begin(), result.required_terms.end()), result.required_terms.end());
 
     return result;
 }
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+template <typename RankingPolicy>
+std::vector<std::string_view> BasicSearchServer<RankingPolicy>::ExpandPrefix(std::string_view prefix) const {
+    std::vector<std::pair<size_t, std::string_view>> terms;
+    TermDictionary::Cursor cursor(term_dictionary_);
+    for (cursor.Seek(prefix); !cursor.AtEnd() && cursor.Value().substr(0, prefix.size()) == prefix; cursor.Next()) {
+        const auto it = word_to_document_freqs_.find(cursor.Value());
+        if (!it->second.empty()) {
+            terms.emplace_back(it->second.size(), it->first);
+        }
+    }
+    if (terms.size() > MAX_PREFIX_EXPANSION_COUNT) {
+        std::nth_element(terms.begin(), terms.begin() + MAX_PREFIX_EXPANSION_COUNT, terms.end(), std::greater<>());
+        terms.resize(MAX_PREFIX_EXPANSION_COUNT);
+    }
+
+    std::vector<std::string_view> result(terms.size());
+    std::transform(terms.begin(), terms.end(), result.begin(), [](const auto& term) {
+        return term.second;
+    });
+    return result;
 }
 
-const std::map<std::string_view, double, std::less<>>& SearchServer::GetWordFrequencies(int document_id) const {
-    return (static_cast<bool>(documents_.count(document_id)) ? documents_words_with_freq_.at(document_id) : empty_map_);
+template <typename RankingPolicy>
+bool BasicSearchServer<RankingPolicy>::ContainsPhrase(const Phrase& phrase, int document_id) const {
+    std::vector<PositionList::Reader> readers;
+    readers.reserve(phrase.size());
+    for (const PhraseWord& word : phrase) {
+        const auto word_it = word_to_document_positions_.find(word.data);
+        if (word_it == word_to_document_positions_.end()) {
+            return false;
+        }
+        const auto document_it = word_it->second.find(document_id);
+        if (document_it == word_it->second.end()) {
+            return false;
+        }
+        readers.emplace_back(document_it->second);
+    }
+
+    // Every reader only moves forward, so the intersection is a single pass over the position lists
+    uint32_t start = 0;
+    for (size_t i = 0; i < readers.size();) {
+        const uint32_t target = start + phrase[i].offset;
+        if (!readers[i].AdvanceTo(target)) {
+            return false;
+        }
+        if (readers[i].Value() != target) {
+            start = readers[i].Value() - phrase[i].offset;
+            i = 0;
+        }
+        else {
+            ++i;
+        }
+    }
+    return true;
 }
 
-std::set<int>::const_iterator SearchServer::begin() const { return document_ids_.begin(); }
+template <typename RankingPolicy>
+std::vector<int> BasicSearchServer<RankingPolicy>::FindPhraseDocuments(const Phrase& phrase) const {
+    const std::map<int, double>* rarest_postings = nullptr;
+    for (const PhraseWord& word : phrase) {
+        const auto it = word_to_document_freqs_.find(word.data);
+        if (it == word_to_document_freqs_.end()) {
+            return {};
+        }
+        if (rarest_postings == nullptr || it->second.size() < rarest_postings->size()) {
+            rarest_postings = &it->second;
+        }
+    }
 
-std::set<int>::const_iterator SearchServer::end() const { return document_ids_.end(); }
+    std::vector<int> document_ids;
+    for (const auto& [document_id, _] : *rarest_postings) {
+        if (ContainsPhrase(phrase, document_id)) {
+            document_ids.push_back(document_id);
+        }
+    }
+    return document_ids;
+}
 
-void SearchServer::RemoveDocument(const std::execution::sequenced_policy& exec_pol, int document_id) {
-    for (auto [word, freq] : documents_words_with_freq_[document_id]) {
-        word_to_document_freqs_[word].erase(document_id);
+template <typename RankingPolicy>
+size_t BasicSearchServer<RankingPolicy>::CountCandidatePostings(const Query& query) const {
+    size_t posting_count = 0;
+    const auto count = [this, &posting_count](std::string_view word) {
+        if (const auto it = word_to_document_freqs_.find(word); it != word_to_document_freqs_.end()) {
+            posting_count += it->second.size();
+        }
+    };
+    std::for_each(query.plus_words.begin(), query.plus_words.end(), count);
+    for (const Phrase& phrase : query.plus_phrases) {
+        for (const PhraseWord& word : phrase) {
+            count(word.data);
+        }
     }
-    documents_words_with_freq_.erase(document_id);
+    for (const FuzzyWord& fuzzy_word : query.fuzzy_words) {
+        for (const FuzzyTerm& term : fuzzy_word) {
+            count(term.data);
+        }
+    }
+    return posting_count;
+}
+
+template <typename RankingPolicy>
+WordFrequencies BasicSearchServer<RankingPolicy>::GetWordFrequencies(int document_id) const {
+    const auto it = documents_.find(document_id);
+    return it != documents_.end() ? WordFrequencies(it->second.words) : WordFrequencies();
+}
+
+template <typename RankingPolicy>
+StoredDocument BasicSearchServer<RankingPolicy>::GetStoredDocument(int document_id) const {
+    CheckDocumentsStored();
+    return document_store_.Get(document_id);
+}
+
+template <typename RankingPolicy>
+std::vector<StoredDocument> BasicSearchServer<RankingPolicy>::GetStoredDocuments(const std::vector<Document>& documents) const {
+    CheckDocumentsStored();
+    std::vector<int> document_ids;
+    document_ids.reserve(documents.size());
+    for (const Document& document : documents) {
+        document_ids.push_back(document.id);
+    }
+    return document_store_.Get(document_ids);
+}
+
+template <typename RankingPolicy>
+std::vector<StoredDocument> BasicSearchServer<RankingPolicy>::GetStoredDocuments(const std::vector<int>& document_ids) const {
+    CheckDocumentsStored();
+    return document_store_.Get(document_ids);
+}
+
+template <typename RankingPolicy>
+DocumentStatus BasicSearchServer<RankingPolicy>::GetDocumentStatus(int document_id) const {
+    return document_attributes_.GetStatus(document_id);
+}
+
+template <typename RankingPolicy>
+bool BasicSearchServer<RankingPolicy>::HasDocument(int document_id) const {
+    return documents_.count(document_id) > 0;
+}
+
+template <typename RankingPolicy>
+int BasicSearchServer<RankingPolicy>::GetDocumentLength(int document_id) const {
+    return document_attributes_.GetLength(document_id);
+}
+
+template <typename RankingPolicy>
+std::vector<Snippet> BasicSearchServer<RankingPolicy>::GetSnippets(std::string_view raw_query, const std::vector<int>& document_ids, size_t window) const {
+    if (window == 0) {
+        throw std::invalid_argument("Snippet window must be positive"s);
+    }
+    if (!options_.store_positions) {
+        throw std::logic_error("Snippets require stored positions, see IndexOptions::store_positions"s);
+    }
+    CheckDocumentsStored();
+
+    const auto query = ParseQuery(std::execution::seq, raw_query);
+    std::vector<std::string_view> words = query.plus_words;
+    for (const Phrase& phrase : query.plus_phrases) {
+        for (const PhraseWord& word : phrase) {
+            words.push_back(word.data);
+        }
+    }
+    for (const FuzzyWord& fuzzy_word : query.fuzzy_words) {
+        for (const FuzzyTerm& term : fuzzy_word) {
+            words.push_back(term.data);
+        }
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    const std::vector<StoredDocument> documents = document_store_.Get(document_ids);
+    std::vector<Snippet> snippets(documents.size());
+    std::transform(std::execution::par, documents.begin(), documents.end(), snippets.begin(), [&](const StoredDocument& document) {
+        return MakeSnippet(words, document, window);
+    });
+    return snippets;
+}
+
+template <typename RankingPolicy>
+Snippet BasicSearchServer<RankingPolicy>::MakeSnippet(const std::vector<std::string_view>& words, const StoredDocument& document, size_t window) const {
+    // Positions of query words in the document, each with the index of its word
+    std::vector<std::pair<uint32_t, size_t>> hits;
+    for (size_t word_index = 0; word_index < words.size(); ++word_index) {
+        const auto word_it = word_to_document_positions_.find(words[word_index]);
+        if (word_it == word_to_document_positions_.end()) {
+            continue;
+        }
+        const auto positions_it = word_it->second.find(document.id);
+        if (positions_it == word_it->second.end()) {
+            continue;
+        }
+        for (PositionList::Reader reader(positions_it->second); !reader.AtEnd(); reader.Next()) {
+            hits.emplace_back(reader.Value(), word_index);
+        }
+    }
+    std::sort(hits.begin(), hits.end());
+
+    // Slide the window over the hits, preferring more distinct words, then more hits, then the earlier window
+    uint32_t best_first_position = 0;
+    size_t best_distinct_count = 0;
+    size_t best_hit_count = 0;
+    std::vector<size_t> counts(words.size());
+    size_t distinct_count = 0;
+    for (size_t begin = 0, end = 0; begin < hits.size(); ++begin) {
+        for (; end < hits.size() && hits[end].first < hits[begin].first + window; ++end) {
+            distinct_count += counts[hits[end].second]++ == 0;
+        }
+        if (distinct_count > best_distinct_count || (distinct_count == best_distinct_count && end - begin > best_hit_count)) {
+            best_first_position = hits[begin].first;
+            best_distinct_count = distinct_count;
+            best_hit_count = end - begin;
+        }
+        distinct_count -= --counts[hits[begin].second] == 0;
+    }
+
+    // Positions count every word of the original text, stop words included; the text is split like SplitIntoWords does
+    // from the recorded offset at or before the window to its end only
+    Snippet snippet;
+    snippet.document_id = document.id;
+    const std::vector<uint32_t>& word_offsets = documents_.at(document.id).word_offsets;
+    const size_t offset_index = best_first_position / WORD_OFFSET_INTERVAL;
+    if (offset_index >= word_offsets.size()) {
+        return snippet;
+    }
+    std::string_view text = std::string_view(document.text).substr(word_offsets[offset_index]);
+    std::vector<std::string_view> window_words;
+    for (size_t position = offset_index * WORD_OFFSET_INTERVAL; position < best_first_position + window; ++position) {
+        text.remove_prefix(std::min(text.find_first_not_of(' '), text.size()));
+        if (text.empty()) {
+            break;
+        }
+        const std::string_view word = text.substr(0, text.find(' '));
+        text.remove_prefix(word.size());
+        if (position >= best_first_position) {
+            window_words.push_back(word);
+        }
+    }
+    if (window_words.empty()) {
+        return snippet;
+    }
+    const size_t last_position = best_first_position + window_words.size() - 1;
+    const size_t text_begin = window_words.front().data() - document.text.data();
+    const size_t text_end = window_words.back().data() + window_words.back().size() - document.text.data();
+    snippet.text = document.text.substr(text_begin, text_end - text_begin);
+    for (const auto& [position, _] : hits) {
+        if (position >= best_first_position && position <= last_position) {
+            const std::string_view word = window_words[position - best_first_position];
+            snippet.highlights.push_back({ static_cast<size_t>(word.data() - document.text.data()) - text_begin, word.size() });
+        }
+    }
+    return snippet;
+}
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::CheckDocumentsStored() const {
+    if (!options_.store_documents) {
+        throw std::logic_error("Documents are not stored, see IndexOptions::store_documents"s);
+    }
+}
+
+template <typename RankingPolicy>
+std::set<int>::const_iterator BasicSearchServer<RankingPolicy>::begin() const { return document_ids_.begin(); }
+
+template <typename RankingPolicy>
+std::set<int>::const_iterator BasicSearchServer<RankingPolicy>::end() const { return document_ids_.end(); }
+
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::RemoveDocument(const std::execution::sequenced_policy& exec_pol, int document_id) {
+    const auto document_it = documents_.find(document_id);
+    if (document_it == documents_.end()) {
+        return;
+    }
+    for (const ForwardIndexEntry& entry : document_it->second.words) {
+        position_bytes_ -= RemovePosting(entry.word, document_id);
+    }
+    position_bytes_ -= GetWordOffsetBytes(document_it->second.word_offsets);
+    for (const ForwardIndexEntry& entry : document_it->second.words) {
+        unused_term_count_ += word_to_document_freqs_.find(entry.word)->second.empty();
+    }
+    posting_count_ -= document_it->second.words.size();
     document_ids_.erase(document_id);
-    documents_.erase(document_id);
+    impacts_ = std::monostate();
+    top_documents_cache_->Invalidate();
+    document_norms_->Invalidate();
+    total_document_length_ -= document_attributes_.GetLength(document_id);
+    document_attributes_.Remove(document_id);
+    documents_.erase(document_it);
+    document_store_.Remove(document_id);
 }
 
-void SearchServer::RemoveDocument(const std::execution::parallel_policy& exec_pol, int document_id) {
-    std::vector<std::string_view> data(documents_words_with_freq_[document_id].size());
-    auto first_of_pair = [] (std::pair<std::string_view, double> pair) {
-        return pair.first;
-    };
-    std::transform (std::execution::par, documents_words_with_freq_[document_id].begin(), documents_words_with_freq_[document_id].end(), data.begin(), first_of_pair);
-    auto deleter = [&] (std::string_view word) {
-        word_to_document_freqs_[word].erase(document_id);
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::RemoveDocument(const std::execution::parallel_policy& exec_pol, int document_id) {
+    const auto document_it = documents_.find(document_id);
+    if (document_it == documents_.end()) {
+        return;
+    }
+    // Every word has its own postings, so they are erased concurrently
+    auto deleter = [&] (const ForwardIndexEntry& entry) {
+        return RemovePosting(entry.word, document_id);
     };
-    std::for_each(std::execution::par, data.begin(), data.end(), deleter);
-    documents_words_with_freq_.erase(document_id);
+    position_bytes_ -= std::transform_reduce(std::execution::par, document_it->second.words.begin(), document_it->second.words.end(),
+                                             size_t(0), std::plus<>(), deleter);
+    position_bytes_ -= GetWordOffsetBytes(document_it->second.word_offsets);
+    for (const ForwardIndexEntry& entry : document_it->second.words) {
+        unused_term_count_ += word_to_document_freqs_.find(entry.word)->second.empty();
+    }
+    posting_count_ -= document_it->second.words.size();
     document_ids_.erase(document_id);
-    documents_.erase(document_id);
+    impacts_ = std::monostate();
+    top_documents_cache_->Invalidate();
+    document_norms_->Invalidate();
+    total_document_length_ -= document_attributes_.GetLength(document_id);
+    document_attributes_.Remove(document_id);
+    documents_.erase(document_it);
+    document_store_.Remove(document_id);
+}
+
+template <typename RankingPolicy>
+size_t BasicSearchServer<RankingPolicy>::RemovePosting(std::string_view word, int document_id) {
+    word_to_document_freqs_.find(word)->second.erase(document_id);
+    const auto word_it = word_to_document_positions_.find(word);
+    if (word_it == word_to_document_positions_.end()) {
+        return 0;
+    }
+    const auto it = word_it->second.find(document_id);
+    if (it == word_it->second.end()) {
+        return 0;
+    }
+    const size_t freed_bytes = POSITION_LIST_BYTES + GetAllocationBytes(it->second.ByteSize());
+    word_it->second.erase(it);
+    return freed_bytes;
 }
 
-void SearchServer::RemoveDocument(int document_id) {
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::RemoveDocument(int document_id) {
     RemoveDocument(std::execution::seq, document_id);
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy, std::string_view raw_query, int document_id) const {
+template <typename RankingPolicy>
+void BasicSearchServer<RankingPolicy>::RemoveDocuments(const std::vector<int>& document_ids) {
+    std::vector<typename std::map<int, DocumentData>::iterator> removed_documents;
+    removed_documents.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        const auto document_it = documents_.find(document_id);
+        if (document_it != documents_.end()) {
+            removed_documents.push_back(document_it);
+        }
+    }
+    std::sort(removed_documents.begin(), removed_documents.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs->first < rhs->first;
+    });
+    removed_documents.erase(std::unique(removed_documents.begin(), removed_documents.end()), removed_documents.end());
+    if (removed_documents.empty()) {
+        return;
+    }
+
+    // Postings grouped by word, so that each word is looked up once and only its own thread touches its postings
+    std::vector<std::pair<std::string_view, int>> postings;
+    for (const auto document_it : removed_documents) {
+        for (const ForwardIndexEntry& entry : document_it->second.words) {
+            postings.emplace_back(entry.word, document_it->first);
+        }
+    }
+    std::sort(std::execution::par, postings.begin(), postings.end());
+    std::vector<size_t> word_starts;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        if (i == 0 || postings[i].first != postings[i - 1].first) {
+            word_starts.push_back(i);
+        }
+    }
+    word_starts.push_back(postings.size());
+
+    std::vector<size_t> freed_position_bytes(word_starts.size() - 1);
+    std::vector<char> is_unused(word_starts.size() - 1);
+    std::vector<size_t> word_indexes(word_starts.size() - 1);
+    std::iota(word_indexes.begin(), word_indexes.end(), size_t(0));
+    std::for_each(std::execution::par, word_indexes.begin(), word_indexes.end(), [&](size_t word_index) {
+        const std::string_view word = postings[word_starts[word_index]].first;
+        auto& document_freqs = word_to_document_freqs_.find(word)->second;
+        const auto positions_it = word_to_document_positions_.find(word);
+        for (size_t i = word_starts[word_index]; i < word_starts[word_index + 1]; ++i) {
+            const int document_id = postings[i].second;
+            document_freqs.erase(document_id);
+            if (positions_it == word_to_document_positions_.end()) {
+                continue;
+            }
+            const auto it = positions_it->second.find(document_id);
+            if (it != positions_it->second.end()) {
+                freed_position_bytes[word_index] += POSITION_LIST_BYTES + GetAllocationBytes(it->second.ByteSize());
+                positions_it->second.erase(it);
+            }
+        }
+        is_unused[word_index] = document_freqs.empty();
+    });
+
+    position_bytes_ -= std::accumulate(freed_position_bytes.begin(), freed_position_bytes.end(), size_t(0));
+    unused_term_count_ += std::count(is_unused.begin(), is_unused.end(), 1);
+    posting_count_ -= postings.size();
+    impacts_ = std::monostate();
+    top_documents_cache_->Invalidate();
+    document_norms_->Invalidate();
+    for (const auto document_it : removed_documents) {
+        const int document_id = document_it->first;
+        position_bytes_ -= GetWordOffsetBytes(document_it->second.word_offsets);
+        document_ids_.erase(document_id);
+        total_document_length_ -= document_attributes_.GetLength(document_id);
+        document_attributes_.Remove(document_id);
+        document_store_.Remove(document_id);
+        documents_.erase(document_it);
+    }
+}
+
+template <typename RankingPolicy>
+std::tuple<std::vector<std::string_view>, DocumentStatus> BasicSearchServer<RankingPolicy>::MatchDocument(const std::execution::sequenced_policy, std::string_view raw_query, int document_id) const {
     if (!document_ids_.count(document_id)) {
         throw std::invalid_argument("document with this id doesn't exist");
     }
     const auto query = ParseQuery(std::execution::seq, raw_query);
     std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it != word_to_document_freqs_.end() && word_it->second.count(document_id)) {
+            return {matched_words,  document_attributes_.GetStatus(document_id)};
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return {matched_words,  documents_.at(document_id).status};
+    }
+    for (const Phrase& phrase : query.minus_phrases) {
+        if (ContainsPhrase(phrase, document_id)) {
+            return { matched_words, document_attributes_.GetStatus(document_id) };
         }
     }
     for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it != word_to_document_freqs_.end() && word_it->second.count(document_id)) {
             matched_words.push_back(word);
         }
     }
-    return { matched_words, documents_.at(document_id).status };
+    for (const FuzzyWord& fuzzy_word : query.fuzzy_words) {
+        for (const FuzzyTerm& term : fuzzy_word) {
+            if (word_to_document_freqs_.at(term.data).count(document_id)) {
+                matched_words.push_back(term.data);
+            }
+        }
+    }
+    if (!query.plus_phrases.empty() || !query.fuzzy_words.empty()) {
+        for (const Phrase& phrase : query.plus_phrases) {
+            if (ContainsPhrase(phrase, document_id)) {
+                for (const PhraseWord& word : phrase) {
+                    matched_words.push_back(word.data);
+                }
+            }
+        }
+        std::sort(matched_words.begin(), matched_words.end());
+        matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
+    }
+    return { matched_words, document_attributes_.GetStatus(document_id) };
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy &policy, std::string_view raw_query, int document_id) const {
+template <typename RankingPolicy>
+std::tuple<std::vector<std::string_view>, DocumentStatus> BasicSearchServer<RankingPolicy>::MatchDocument(const std::execution::parallel_policy &policy, std::string_view raw_query, int document_id) const {
     const auto query = ParseQuery(std::execution::par, raw_query);
+    const WordFrequencies document_words(documents_.at(document_id).words);
     auto is_in_doc = [&] (std::string_view word) {
-        return documents_words_with_freq_.at(document_id).count(word) > 0;
+        return document_words.count(word) > 0;
+    };
+    auto is_phrase_in_doc = [&] (const Phrase& phrase) {
+        return ContainsPhrase(phrase, document_id);
     };
     std::vector<std::string_view> matched_words;
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), is_in_doc)) {
-        return { matched_words, documents_.at(document_id).status };
+    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), is_in_doc)
+        || std::any_of(std::execution::par, query.minus_phrases.begin(), query.minus_phrases.end(), is_phrase_in_doc)) {
+        return { matched_words, document_attributes_.GetStatus(document_id) };
     }
     matched_words.resize(query.plus_words.size());
     matched_words.erase(std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), is_in_doc), matched_words.end());
+    for (const Phrase& phrase : query.plus_phrases) {
+        if (is_phrase_in_doc(phrase)) {
+            for (const PhraseWord& word : phrase) {
+                matched_words.push_back(word.data);
+            }
+        }
+    }
+    for (const FuzzyWord& fuzzy_word : query.fuzzy_words) {
+        for (const FuzzyTerm& term : fuzzy_word) {
+            if (is_in_doc(term.data)) {
+                matched_words.push_back(term.data);
+            }
+        }
+    }
     std::sort(std::execution::par, matched_words.begin(), matched_words.end());
     matched_words.erase(std::unique(std::execution::par, matched_words.begin(), matched_words.end()), matched_words.end());
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, document_attributes_.GetStatus(document_id) };
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+template <typename RankingPolicy>
+std::tuple<std::vector<std::string_view>, DocumentStatus> BasicSearchServer<RankingPolicy>::MatchDocument(std::string_view raw_query, int document_id) const {
     return MatchDocument(std::execution::seq, raw_query, document_id);
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentStatus status) const {
+template <typename RankingPolicy>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentStatus status) const {
+    if (auto documents = FindHotTermTopDocuments(raw_query, status)) {
+        return std::move(*documents);
+    }
     return FindTopDocuments(std::execution::par, raw_query, [status](const int id, const DocumentStatus doc_status, const int rating)  {
         return status == doc_status;
     });
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query) const {
+template <typename RankingPolicy>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query) const {
     return FindTopDocuments(std::execution::par, raw_query, DocumentStatus::ACTUAL);
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentStatus status) const {
+template <typename RankingPolicy>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentStatus status) const {
     return FindTopDocuments(std::execution::seq, raw_query, [status](const int id, const DocumentStatus doc_status, const int rating)  {
         return status == doc_status;
     });
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query) const {
+template <typename RankingPolicy>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query) const {
     return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
-}
\ No newline at end of file
+}
+
+template <typename RankingPolicy>
+FacetedSearchResult BasicSearchServer<RankingPolicy>::FindTopDocumentsWithFacets(std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocumentsWithFacets(raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+template <typename RankingPolicy>
+FacetedSearchResult BasicSearchServer<RankingPolicy>::FindTopDocumentsWithFacets(std::string_view raw_query) const {
+    return FindTopDocumentsWithFacets(raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename RankingPolicy>
+FacetedSearchResult BasicSearchServer<RankingPolicy>::FindTopDocumentsWithFacets(const std::execution::parallel_policy&, std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocumentsWithFacets(std::execution::par, raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+template <typename RankingPolicy>
+FacetedSearchResult BasicSearchServer<RankingPolicy>::FindTopDocumentsWithFacets(const std::execution::parallel_policy&, std::string_view raw_query) const {
+    return FindTopDocumentsWithFacets(std::execution::par, raw_query, DocumentStatus::ACTUAL);
+}
+
+template class BasicSearchServer<TfIdfRanking>;
+template class BasicSearchServer<Bm25Ranking>;
@@ -13,26 +13,89 @@
 #include <utility>
 #include <cassert>
 #include <deque>
+#include <optional>
+#include <variant>
+#include <array>
+#include <limits>
+#include <memory>
 
 #include "string_processing.h"
 #include "read_input_functions.h"
 #include "document.h"
 #include "concurrent_map.h"
+#include "position_list.h"
+#include "term_dictionary.h"
+#include "ranking.h"
+#include "impact_index.h"
+#include "document_store.h"
+#include "word_frequencies.h"
+#include "memory_usage.h"
+#include "bloom_filter.h"
+#include "levenshtein_automaton.h"
+#include "posting_cursor.h"
+#include "document_reordering.h"
+#include "top_documents_cache.h"
+#include "document_attributes.h"
+#include "search_facets.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
+// A "prefix*" query word matches at most this many of the most frequent terms
+const int MAX_PREFIX_EXPANSION_COUNT = 64;
+
+// A "~word" query word also matches the terms within this many edits, the closest and most frequent ones
+// if there are too many; words of up to SHORT_FUZZY_WORD_LENGTH characters allow a single edit
+const int MAX_FUZZY_DISTANCE = 2;
+const size_t SHORT_FUZZY_WORD_LENGTH = 4;
+const int MAX_FUZZY_EXPANSION_COUNT = 64;
+
+// Relevance factor of a fuzzy match per edit
+const double FUZZY_EDIT_PENALTY = 0.5;
+
+// A document indexed with positions and stored keeps the byte offset of every this many words of its text,
+// where snippets start splitting it
+const uint32_t WORD_OFFSET_INTERVAL = 16;
+
 using  std::string_literals::operator ""s;
 
-class SearchServer {
+struct IndexOptions {
+    // Record word positions of every document, required for "quoted phrase" queries
+    bool store_positions = false;
+    // Keep original texts and ratings in a compressed document store, see GetStoredDocuments
+    bool store_documents = false;
+    // Estimated size in bytes (see GetMemoryUsage) above which AddDocument evicts caches and compacts, zero for none
+    size_t soft_memory_limit = 0;
+    // Estimated size in bytes AddDocument refuses to exceed by throwing std::length_error, zero for none
+    size_t hard_memory_limit = 0;
+    // Single-word queries by status for terms in at least this many documents are answered from lists ranked
+    // once per change of the index, zero for none
+    size_t hot_term_document_count = 1000;
+};
+
+enum class QueryMode {
+    // Documents containing any plus word or phrase of the query
+    ANY_WORD,
+    // Documents containing every plus word and phrase, and any term of every prefix and fuzzy word
+    ALL_WORDS,
+};
+
+// Ranking policies are described in ranking.h; the server is instantiated for each of them in search_server.cpp
+template <typename RankingPolicy = TfIdfRanking>
+class BasicSearchServer {
 public:
-    SearchServer() = default;
+    BasicSearchServer() = default;
 
     template <typename StringContainer>
-    SearchServer(const StringContainer& stop_words);
+    BasicSearchServer(const StringContainer& stop_words, const IndexOptions& options = {});
+
+    explicit BasicSearchServer(std::string_view stop_words_text, const IndexOptions& options = {});
 
-    explicit SearchServer(std::string_view stop_words_text);
+    explicit BasicSearchServer(std::string stop_words_text, const IndexOptions& options = {});
 
-    explicit SearchServer(std::string stop_words_text);
+    // Deep copy, index keys of the copy view its own word pool
+    BasicSearchServer(const BasicSearchServer& other);
+
+    BasicSearchServer(BasicSearchServer&& other) = default;
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
@@ -50,6 +113,10 @@ public:
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
 
+    // Ranks with the statistics of a whole collection this index is a part of, see GetQueryStatistics
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, const CollectionStatistics& collection) const;
+
 
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentStatus status) const;
 
@@ -58,13 +125,94 @@ public:
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
 
+    // Documents of QueryMode::ALL_WORDS are ranked as they are in the default QueryMode::ANY_WORD
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, QueryMode mode, DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, QueryMode mode, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, QueryMode mode) const;
+
+    // Returns the page of up to page_size documents ranked right after the cursor (from the top when it is empty)
+    template <typename DocumentPredicate>
+    SearchPage FindTopDocumentsAfter(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& after, DocumentPredicate document_predicate) const;
+
+    SearchPage FindTopDocumentsAfter(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& after, DocumentStatus status) const;
+
+    SearchPage FindTopDocumentsAfter(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& after = std::nullopt) const;
+
+    // Top documents the predicate accepts, with the facets of all the documents matching the query, accepted or
+    // not, counted in the same pass over the scored documents
+    template <typename DocumentPredicate>
+    FacetedSearchResult FindTopDocumentsWithFacets(std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    FacetedSearchResult FindTopDocumentsWithFacets(std::string_view raw_query, DocumentStatus status) const;
+
+    FacetedSearchResult FindTopDocumentsWithFacets(std::string_view raw_query) const;
+
+    // The scored documents are split into partitions with facets of their own, merged at the end
+    template <typename DocumentPredicate>
+    FacetedSearchResult FindTopDocumentsWithFacets(const std::execution::parallel_policy&, std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    FacetedSearchResult FindTopDocumentsWithFacets(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentStatus status) const;
+
+    FacetedSearchResult FindTopDocumentsWithFacets(const std::execution::parallel_policy& policy, std::string_view raw_query) const;
+
+    // Precomputes quantized scores of every posting of the current index, after which queries without phrases
+    // accumulate small integers instead of doubles; the next AddDocument or RemoveDocument drops them.
+    // The double postings stay, as every other query path and the next write read them, so sealing adds the
+    // impacts to the posting memory rather than replacing it.
+    void SealImpacts(ImpactPrecision precision);
+
+    // Numbers the documents of the impacts in the order given, reporting the size of the ordinal gaps of the
+    // postings in it against the ascending id order. DocumentOrder::CLUSTERED shrinks the sealed postings
+    // and keeps the score updates of a term close together, at the cost of an offline reordering pass.
+    ReorderingReport SealImpacts(ImpactPrecision precision, DocumentOrder order);
+
     int GetDocumentCount() const;
 
+    // Estimated from the sizes of the index structures, not measured by the allocator
+    MemoryUsage GetMemoryUsage() const;
+
+    // Drops terms left without documents, rewrites the document store without removed documents and clears its cache
+    void Compact();
+
+    CorpusStatistics GetCorpusStatistics() const;
+
+    // Corpus statistics and document frequencies of the words the query would be ranked by
+    CollectionStatistics GetQueryStatistics(std::string_view raw_query) const;
+
+    // Ranking order of the results: relevance rounded down to a multiple of 1e-6, then rating, then id.
+    // A strict total order, so that result pages neither skip nor repeat documents.
+    static bool IsRankedBefore(const Document& lhs, const Document& rhs);
+
     std::set<int>::const_iterator begin() const;
 
     std::set<int>::const_iterator end() const;
 
-    const std::map<std::string_view, double, std::less<>>& GetWordFrequencies(int document_id) const;
+    // Empty for an unknown document
+    WordFrequencies GetWordFrequencies(int document_id) const;
+
+    // Original text and ratings, requires IndexOptions::store_documents
+    StoredDocument GetStoredDocument(int document_id) const;
+
+    // Stored documents of search results, in their order
+    std::vector<StoredDocument> GetStoredDocuments(const std::vector<Document>& documents) const;
+
+    // Stored documents in the order of the ids
+    std::vector<StoredDocument> GetStoredDocuments(const std::vector<int>& document_ids) const;
+
+    // Throws std::out_of_range for an unknown document
+    DocumentStatus GetDocumentStatus(int document_id) const;
+
+    bool HasDocument(int document_id) const;
+
+    // Number of non-stop words, the length the ranking normalizes by; throws std::out_of_range for an unknown document
+    int GetDocumentLength(int document_id) const;
+
+    // For every document, the window of consecutive words holding the most distinct query words, highlighted.
+    // Requires both IndexOptions::store_positions and IndexOptions::store_documents.
+    std::vector<Snippet> GetSnippets(std::string_view raw_query, const std::vector<int>& document_ids, size_t window) const;
 
     void RemoveDocument(int document_id);
 
@@ -72,6 +220,10 @@ public:
 
     void RemoveDocument(const std::execution::sequenced_policy& exec_pol, int document_id);
 
+    // Removes the documents in a single pass over the postings of every word they hold, the words concurrently,
+    // and updates the statistics and caches once. Unknown and repeated ids are ignored.
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy, std::string_view raw_query, int document_id) const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy& policy, std::string_view raw_query, int document_id) const;
@@ -79,31 +231,76 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
 private:
     struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::set<std::string> words;
+        // Forward index of the document, sorted by word
+        std::vector<ForwardIndexEntry> words;
+        // Byte offsets in the text of the words at multiples of WORD_OFFSET_INTERVAL
+        std::vector<uint32_t> word_offsets;
     };
-    std::map<std::string_view, double, std::less<>> empty_map_;
-    std::map<int, std::map<std::string_view, double, std::less<>>> documents_words_with_freq_;
     const std::set<std::string, std::less<>> stop_words_;
+    // The only copy of every term, all index keys view it
+    std::set<std::string, std::less<>> word_pool_;
+    // Inverted index, the forward index entries point to its frequencies
     std::map<std::string_view, std::map<int, double>, std::less<>> word_to_document_freqs_;
+    std::map<std::string_view, std::map<int, PositionList>, std::less<>> word_to_document_positions_;
+    TermDictionary term_dictionary_;
+    // Rejects most absent query words before any index lookup
+    BloomFilter term_filter_;
+    std::variant<std::monostate, ImpactIndex<uint8_t>, ImpactIndex<uint16_t>> impacts_;
     std::map<int, DocumentData> documents_;
+    // Status, rating and length of the documents, the length being the number of non-stop words
+    // ranking policies derive their document norms from
+    DocumentAttributes document_attributes_;
     std::set<int> document_ids_;
+    int64_t total_document_length_ = 0;
+    DocumentStore document_store_;
+    std::unique_ptr<TopDocumentsCache> top_documents_cache_ = std::make_unique<TopDocumentsCache>();
+    std::unique_ptr<DocumentNormsCache> document_norms_ = std::make_unique<DocumentNormsCache>();
+    // Running estimates of GetMemoryUsage
+    size_t lexicon_bytes_ = 0;
+    size_t posting_count_ = 0;
+    size_t position_bytes_ = 0;
+    // Terms all documents of which were removed, Compact drops them
+    size_t unused_term_count_ = 0;
+    const IndexOptions options_;
 
     bool IsStopWord(std::string_view word) const;
 
     static bool IsValidWord(std::string_view word);
 
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string& text) const;
+    std::vector<std::string> SplitIntoWordsNoStop(std::string_view text) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    void CheckDocumentsStored() const;
+
+    // Estimated bytes the document would add to the index
+    size_t EstimateDocumentBytes(const std::map<std::string_view, double>& word_freqs, size_t word_count, std::string_view document) const;
+
+    // Makes room for bytes under the hard memory limit, compacting if needed, or throws std::length_error
+    void ReserveMemory(size_t bytes);
+
+    // Compacts the parts of the index that are wasted by at least a fraction, so that repeated calls stay cheap
+    void CompactOverSoftLimit();
+
+    void RemoveUnusedTerms();
+
+    // Grows the filter when it is over capacity, rebuilding it from the word pool
+    void AddToTermFilter(std::string_view word);
+
+    // Erases the postings and positions of a document word, returns the position bytes freed
+    size_t RemovePosting(std::string_view word, int document_id);
+
+    // Snippet highlighting words, the plus words, the words of plus phrases and the fuzzy expansions of a query
+    Snippet MakeSnippet(const std::vector<std::string_view>& words, const StoredDocument& document, size_t window) const;
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;
+        bool is_fuzzy;
         operator std::string () const {
-            return data.data();
+            return std::string(data);
         }
         operator std::string_view () const {
             return data;
@@ -112,49 +309,132 @@ private:
 
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    // Results of a single-word query of a hot term, see IndexOptions::hot_term_document_count; nullopt for other queries
+    std::optional<std::vector<Document>> FindHotTermTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+    static SearchPage SelectPage(std::vector<Document> matched_documents, size_t page_size, const std::optional<SearchCursor>& after);
+
+    struct PhraseWord {
+        std::string_view data;
+        // Distance from the first word of the phrase, stop words included
+        uint32_t offset;
+    };
+
+    using Phrase = std::vector<PhraseWord>;
+
+    struct FuzzyTerm {
+        std::string_view data;
+        // Relevance factor, FUZZY_EDIT_PENALTY to the power of the edit distance
+        double weight;
+    };
+
+    // Expansions of a "~word", a document is ranked by the best of them it contains
+    using FuzzyWord = std::vector<FuzzyTerm>;
+
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        std::vector<Phrase> plus_phrases;
+        std::vector<Phrase> minus_phrases;
+        std::vector<FuzzyWord> fuzzy_words;
+        // For QueryMode::ALL_WORDS, the terms any of which satisfies each plus word, prefix, fuzzy word and word
+        // of a plus phrase; an empty list is never satisfied
+        std::vector<std::vector<std::string_view>> required_terms;
     };
 
     Query ParseQuery(const std::execution::parallel_policy&, std::string_view text) const;
 
+    void AddPhrase(Query& query, Phrase phrase, bool is_minus) const;
+
+    // Indexed terms starting with prefix, the most frequent ones if there are too many
+    std::vector<std::string_view> ExpandPrefix(std::string_view prefix) const;
+
+    // Indexed terms within the edit distance of word, see MAX_FUZZY_DISTANCE
+    FuzzyWord ExpandFuzzy(std::string_view word) const;
+
     Query ParseQuery(const std::execution::sequenced_policy&, std::string_view text) const;
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // Drops the words the term filter rules out, and the phrases containing them, as they match nothing
+    void DropAbsentWords(Query& query) const;
+
+    bool ContainsPhrase(const Phrase& phrase, int document_id) const;
+
+    // Upper bound of the postings a query scores, telling whether a predicate filter bitmap pays off
+    size_t CountCandidatePostings(const Query& query) const;
+
+    // Ids of the documents containing the phrase, in ascending order
+    std::vector<int> FindPhraseDocuments(const Phrase& phrase) const;
+
+    // Existence required, in the collection when it is given
+    int GetDocumentFreq(std::string_view word, const CollectionStatistics* collection) const;
+
+    // Norms of the ranking policy for the corpus statistics, empty for policies without them
+    std::shared_ptr<const DocumentNorms> GetDocumentNorms(const CorpusStatistics& corpus) const;
+
+    // Norm of the document at the cursor, zero for policies without norms
+    static double GetDocumentNorm(const DocumentNorms& norms, const DocumentAttributes::Cursor& document) {
+        if constexpr (RankingPolicy::HAS_DOCUMENT_NORMS) {
+            return norms.Get(document);
+        } else {
+            return 0.0;
+        }
+    }
+
+    // Relevance of the documents matching the query that the filter accepts, by id
+    template <typename DocumentPredicate>
+    std::map<int, double> ScoreDocuments(const Query& query, const PredicateFilter<DocumentPredicate>& accepts, const CollectionStatistics* collection) const;
+
+    // Relevance of the documents matching the query that the filter accepts, in ascending id order
+    template <typename DocumentPredicate>
+    std::vector<std::pair<int, double>> ScoreDocuments(const std::execution::parallel_policy&, const Query& query, const PredicateFilter<DocumentPredicate>& accepts) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate, const CollectionStatistics* collection = nullptr) const;
 
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+
+    // Best relevance every document gets from the expansions of the fuzzy word
+    template <typename DocumentPredicate>
+    std::map<int, double> FindFuzzyWordDocuments(const FuzzyWord& fuzzy_word, const RankingPolicy& ranking, const DocumentNorms& norms, const PredicateFilter<DocumentPredicate>& accepts, const CollectionStatistics* collection) const;
+
+    // Document at a time, skipping through the postings of every other requirement to the candidates of the rarest one
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocumentsWithAllWords(const Query& query, DocumentPredicate document_predicate) const;
+
+    bool CanUseImpacts(const Query& query) const;
+
+    // Relevance of the documents matching the query by the sealed impacts, in ascending id order
+    std::vector<std::pair<int, double>> ScoreDocumentsByImpacts(const Query& query) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocumentsByImpacts(const Query& query, DocumentPredicate document_predicate) const;
+
+    // Counts the scored documents, given in ascending id order, into the facets, keeping those the predicate accepts
+    template <typename Iterator, typename DocumentPredicate>
+    FacetedSearchResult CollectFacetedDocuments(Iterator first, Iterator last, DocumentPredicate document_predicate) const;
 };
 
+using SearchServer = BasicSearchServer<>;
 
+template <typename RankingPolicy>
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
+BasicSearchServer<RankingPolicy>::BasicSearchServer(const StringContainer& stop_words, const IndexOptions& options)
         : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
+        , options_(options)
 {
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw std::invalid_argument("Some of stop words are invalid"s);
     }
 }
 
+template <typename RankingPolicy>
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
     const auto query = ParseQuery(std::execution::seq, raw_query);
     auto matched_documents = FindAllDocuments(query, document_predicate);
 
-    std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        const double error = 1e-6;
-        if (std::abs(lhs.relevance - rhs.relevance) < error) {
-            return lhs.rating > rhs.rating;
-        }
-        else {
-            return lhs.relevance > rhs.relevance;
-        }
-    });
+    std::sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
 
     if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
         matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
@@ -163,21 +443,116 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
     return matched_documents;
 }
 
+template <typename RankingPolicy>
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy&, std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(const std::execution::parallel_policy&, std::string_view raw_query, DocumentPredicate document_predicate) const {
     const auto query = ParseQuery(std::execution::seq, raw_query);
     auto matched_documents = FindAllDocuments(std::execution::par, query, document_predicate);
 
-    std::sort(std::execution::par, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        const double error = 1e-6;
-        if (std::abs(lhs.relevance - rhs.relevance) < error) {
-            return lhs.rating > rhs.rating;
-        }
-        else {
-            return lhs.relevance > rhs.relevance;
-        }
+    std::sort(std::execution::par, matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+
+    return matched_documents;
+}
+
+template <typename RankingPolicy>
+template <typename DocumentPredicate>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, const CollectionStatistics& collection) const {
+    const auto query = ParseQuery(std::execution::seq, raw_query);
+    auto matched_documents = FindAllDocuments(query, document_predicate, &collection);
+
+    std::sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+
+    return matched_documents;
+}
+
+template <typename RankingPolicy>
+template <typename DocumentPredicate>
+SearchPage BasicSearchServer<RankingPolicy>::FindTopDocumentsAfter(std::string_view raw_query, size_t page_size, const std::optional<SearchCursor>& after, DocumentPredicate document_predicate) const {
+    if (page_size == 0) {
+        throw std::invalid_argument("Page size must be positive"s);
+    }
+    const auto query = ParseQuery(std::execution::seq, raw_query);
+    return SelectPage(FindAllDocuments(query, document_predicate), page_size, after);
+}
+
+template <typename RankingPolicy>
+template <typename DocumentPredicate>
+FacetedSearchResult BasicSearchServer<RankingPolicy>::FindTopDocumentsWithFacets(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    const auto query = ParseQuery(std::execution::seq, raw_query);
+    FacetedSearchResult result;
+    if (CanUseImpacts(query)) {
+        const auto scored_documents = ScoreDocumentsByImpacts(query);
+        result = CollectFacetedDocuments(scored_documents.begin(), scored_documents.end(), document_predicate);
+    } else {
+        // The facets count the documents the predicate rejects too, so it can only be applied once they are scored
+        const PredicateFilter accepts_all(document_attributes_, [](int, DocumentStatus, int) { return true; }, 0);
+        const auto document_to_relevance = ScoreDocuments(query, accepts_all, nullptr);
+        result = CollectFacetedDocuments(document_to_relevance.begin(), document_to_relevance.end(), document_predicate);
+    }
+    std::sort(result.documents.begin(), result.documents.end(), IsRankedBefore);
+
+    if (result.documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        result.documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return result;
+}
+
+template <typename RankingPolicy>
+template <typename DocumentPredicate>
+FacetedSearchResult BasicSearchServer<RankingPolicy>::FindTopDocumentsWithFacets(const std::execution::parallel_policy&, std::string_view raw_query, DocumentPredicate document_predicate) const {
+    // Fewer documents are not worth a task of their own
+    const size_t MIN_PARTITION_SIZE = 4096;
+    const auto query = ParseQuery(std::execution::seq, raw_query);
+    std::vector<std::pair<int, double>> scored_documents;
+    if (CanUseImpacts(query)) {
+        scored_documents = ScoreDocumentsByImpacts(query);
+    } else {
+        const PredicateFilter accepts_all(document_attributes_, [](int, DocumentStatus, int) { return true; }, 0);
+        scored_documents = ScoreDocuments(std::execution::par, query, accepts_all);
+    }
+
+    const size_t partition_count = std::max<size_t>(1, scored_documents.size() / MIN_PARTITION_SIZE);
+    std::vector<FacetedSearchResult> partitions(partition_count);
+    std::vector<size_t> partition_indexes(partition_count);
+    std::iota(partition_indexes.begin(), partition_indexes.end(), 0);
+    std::for_each(std::execution::par, partition_indexes.begin(), partition_indexes.end(), [&](size_t index) {
+        partitions[index] = CollectFacetedDocuments(scored_documents.begin() + scored_documents.size() * index / partition_count,
+                                                    scored_documents.begin() + scored_documents.size() * (index + 1) / partition_count,
+                                                    document_predicate);
     });
 
+    FacetedSearchResult result = std::move(partitions.front());
+    for (size_t index = 1; index < partition_count; ++index) {
+        result.facets += partitions[index].facets;
+        result.documents.insert(result.documents.end(), partitions[index].documents.begin(), partitions[index].documents.end());
+    }
+    std::sort(std::execution::par, result.documents.begin(), result.documents.end(), IsRankedBefore);
+
+    if (result.documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        result.documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return result;
+}
+
+template <typename RankingPolicy>
+template <typename DocumentPredicate>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(std::string_view raw_query, QueryMode mode, DocumentPredicate document_predicate) const {
+    if (mode == QueryMode::ANY_WORD) {
+        return FindTopDocuments(raw_query, document_predicate);
+    }
+    const auto query = ParseQuery(std::execution::seq, raw_query);
+    auto matched_documents = FindAllDocumentsWithAllWords(query, document_predicate);
+
+    std::sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+
     if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
         matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
@@ -185,72 +560,336 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::execution::paral
     return matched_documents;
 }
 
+template <typename RankingPolicy>
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const SearchServer::Query& query, DocumentPredicate document_predicate) const {
+std::map<int, double> BasicSearchServer<RankingPolicy>::ScoreDocuments(const Query& query, const PredicateFilter<DocumentPredicate>& accepts, const CollectionStatistics* collection) const {
+    const CorpusStatistics corpus = collection == nullptr ? GetCorpusStatistics() : collection->corpus;
+    const RankingPolicy ranking(corpus);
+    const auto norms = GetDocumentNorms(corpus);
     std::map<int, double> document_to_relevance;
     for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end()) {
             continue;
         }
-        if (word_to_document_freqs_.count(word)) {
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq]: word_to_document_freqs_.at(word)) {
-                const auto &document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
-                }
+        const auto& postings = word_it->second;
+        const double term_weight = ranking.TermWeight(GetDocumentFreq(word, collection));
+        DocumentAttributes::Cursor document(document_attributes_);
+        for (const auto [document_id, term_freq]: postings) {
+            document.Seek(document_id);
+            if (accepts(document)) {
+                document_to_relevance[document_id] += ranking.Score(term_weight, term_freq, GetDocumentNorm(*norms, document));
             }
         }
     }
 
+    for (const Phrase& phrase : query.plus_phrases) {
+        DocumentAttributes::Cursor document(document_attributes_);
+        for (const int document_id : FindPhraseDocuments(phrase)) {
+            document.Seek(document_id);
+            if (!accepts(document)) {
+                continue;
+            }
+            for (const PhraseWord& word : phrase) {
+                const auto& postings = word_to_document_freqs_.at(word.data);
+                document_to_relevance[document_id] += ranking.Score(ranking.TermWeight(GetDocumentFreq(word.data, collection)), postings.at(document_id), GetDocumentNorm(*norms, document));
+            }
+        }
+    }
+
+    for (const FuzzyWord& fuzzy_word : query.fuzzy_words) {
+        for (const auto [document_id, relevance] : FindFuzzyWordDocuments(fuzzy_word, ranking, *norms, accepts, collection)) {
+            document_to_relevance[document_id] += relevance;
+        }
+    }
+
     for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end()) {
             continue;
         }
-        for (const auto[document_id, _] : word_to_document_freqs_.at(word)) {
+        for (const auto[document_id, _] : word_it->second) {
             document_to_relevance.erase(document_id);
         }
     }
 
+    for (const Phrase& phrase : query.minus_phrases) {
+        for (const int document_id : FindPhraseDocuments(phrase)) {
+            document_to_relevance.erase(document_id);
+        }
+    }
+
+    return document_to_relevance;
+}
+
+template <typename RankingPolicy>
+template <typename DocumentPredicate>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindAllDocuments(const Query& query, DocumentPredicate document_predicate, const CollectionStatistics* collection) const {
+    if (collection == nullptr && CanUseImpacts(query)) {
+        return FindAllDocumentsByImpacts(query, document_predicate);
+    }
+    const PredicateFilter accepts(document_attributes_, document_predicate, CountCandidatePostings(query));
     std::vector<Document> matched_documents;
-    for (const auto[document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    DocumentAttributes::Cursor document(document_attributes_);
+    for (const auto[document_id, relevance] : ScoreDocuments(query, accepts, collection)) {
+        document.Seek(document_id);
+        matched_documents.push_back({ document_id, relevance, document.GetRating() });
     }
     return matched_documents;
 }
 
+template <typename RankingPolicy>
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const SearchServer::Query& query, DocumentPredicate document_predicate) const {
+std::vector<std::pair<int, double>> BasicSearchServer<RankingPolicy>::ScoreDocuments(const std::execution::parallel_policy&, const Query& query, const PredicateFilter<DocumentPredicate>& accepts) const {
+    const CorpusStatistics corpus = GetCorpusStatistics();
+    const RankingPolicy ranking(corpus);
+    const auto norms = GetDocumentNorms(corpus);
     ConcurrentMap<int, double> document_to_relevance(100);
     std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), [&](std::string_view word){
-        if (word_to_document_freqs_.count(word) > 0) {
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq]: word_to_document_freqs_.at(word)) {
-                const auto &document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+        if (const auto word_it = word_to_document_freqs_.find(word); word_it != word_to_document_freqs_.end()) {
+            const auto& postings = word_it->second;
+            const double term_weight = ranking.TermWeight(postings.size());
+            DocumentAttributes::Cursor document(document_attributes_);
+            for (const auto [document_id, term_freq]: postings) {
+                document.Seek(document_id);
+                if (accepts(document)) {
+                    document_to_relevance[document_id].ref_to_value += ranking.Score(term_weight, term_freq, GetDocumentNorm(*norms, document));
                 }
             }
         }
     });
 
+    std::for_each(std::execution::par, query.plus_phrases.begin(), query.plus_phrases.end(), [&](const Phrase& phrase) {
+        DocumentAttributes::Cursor document(document_attributes_);
+        for (const int document_id : FindPhraseDocuments(phrase)) {
+            document.Seek(document_id);
+            if (!accepts(document)) {
+                continue;
+            }
+            for (const PhraseWord& word : phrase) {
+                const auto& postings = word_to_document_freqs_.at(word.data);
+                document_to_relevance[document_id].ref_to_value += ranking.Score(ranking.TermWeight(postings.size()), postings.at(document_id), GetDocumentNorm(*norms, document));
+            }
+        }
+    });
+
+    std::for_each(std::execution::par, query.fuzzy_words.begin(), query.fuzzy_words.end(), [&](const FuzzyWord& fuzzy_word) {
+        for (const auto [document_id, relevance] : FindFuzzyWordDocuments(fuzzy_word, ranking, *norms, accepts, nullptr)) {
+            document_to_relevance[document_id].ref_to_value += relevance;
+        }
+    });
+
     std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&] (std::string_view word) {
-        if (word_to_document_freqs_.count(word) > 0) {
-            for (const auto[document_id, _] : word_to_document_freqs_.at(word)) {
+        if (const auto word_it = word_to_document_freqs_.find(word); word_it != word_to_document_freqs_.end()) {
+            for (const auto[document_id, _] : word_it->second) {
                 document_to_relevance.Erase(document_id);
             }
         }
     });
 
-    auto vec_document_to_relevance = document_to_relevance.BuildOrdinaryMap();
+    std::for_each(std::execution::par, query.minus_phrases.begin(), query.minus_phrases.end(), [&] (const Phrase& phrase) {
+        for (const int document_id : FindPhraseDocuments(phrase)) {
+            document_to_relevance.Erase(document_id);
+        }
+    });
+
+    auto scored_documents = document_to_relevance.BuildVecPair();
+    std::sort(std::execution::par, scored_documents.begin(), scored_documents.end());
+    return scored_documents;
+}
+
+template <typename RankingPolicy>
+template <typename DocumentPredicate>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
+    if (CanUseImpacts(query)) {
+        return FindAllDocumentsByImpacts(query, document_predicate);
+    }
+    const PredicateFilter accepts(document_attributes_, document_predicate, CountCandidatePostings(query));
+    std::vector<Document> matched_documents;
+    DocumentAttributes::Cursor document(document_attributes_);
+    for (const auto& [document_id, relevance] : ScoreDocuments(std::execution::par, query, accepts)) {
+        document.Seek(document_id);
+        matched_documents.emplace_back(document_id, relevance, document.GetRating());
+    }
+    return matched_documents;
+}
+
+template <typename RankingPolicy>
+template <typename DocumentPredicate>
+std::map<int, double> BasicSearchServer<RankingPolicy>::FindFuzzyWordDocuments(const FuzzyWord& fuzzy_word, const RankingPolicy& ranking, const DocumentNorms& norms, const PredicateFilter<DocumentPredicate>& accepts, const CollectionStatistics* collection) const {
+    std::map<int, double> document_to_relevance;
+    for (const FuzzyTerm& term : fuzzy_word) {
+        const double term_weight = ranking.TermWeight(GetDocumentFreq(term.data, collection));
+        DocumentAttributes::Cursor document(document_attributes_);
+        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(term.data)) {
+            document.Seek(document_id);
+            if (accepts(document)) {
+                double& relevance = document_to_relevance[document_id];
+                relevance = std::max(relevance, term.weight * ranking.Score(term_weight, term_freq, GetDocumentNorm(norms, document)));
+            }
+        }
+    }
+    return document_to_relevance;
+}
+
+template <typename RankingPolicy>
+template <typename DocumentPredicate>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindAllDocumentsWithAllWords(const Query& query, DocumentPredicate document_predicate) const {
+    std::vector<Document> matched_documents;
+    if (query.required_terms.empty()) {
+        return matched_documents;
+    }
+    // Cursors over the postings of the terms of every requirement, by their total posting count
+    std::vector<std::pair<size_t, std::vector<PostingCursor>>> requirements;
+    requirements.reserve(query.required_terms.size());
+    for (const auto& terms : query.required_terms) {
+        std::vector<PostingCursor> cursors;
+        size_t posting_count = 0;
+        for (const std::string_view term : terms) {
+            if (const auto word_it = word_to_document_freqs_.find(term); word_it != word_to_document_freqs_.end() && !word_it->second.empty()) {
+                cursors.emplace_back(word_it->second);
+                posting_count += word_it->second.size();
+            }
+        }
+        if (cursors.empty()) {
+            return matched_documents;
+        }
+        requirements.emplace_back(posting_count, std::move(cursors));
+    }
+    std::sort(requirements.begin(), requirements.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+
+    const CorpusStatistics corpus = GetCorpusStatistics();
+    const RankingPolicy ranking(corpus);
+    const auto norms = GetDocumentNorms(corpus);
+    std::vector<std::pair<const std::map<int, double>*, double>> plus_postings;
+    for (const std::string_view word : query.plus_words) {
+        const auto& postings = word_to_document_freqs_.at(word);
+        plus_postings.emplace_back(&postings, ranking.TermWeight(postings.size()));
+    }
+    for (const Phrase& phrase : query.plus_phrases) {
+        for (const PhraseWord& word : phrase) {
+            const auto& postings = word_to_document_freqs_.at(word.data);
+            plus_postings.emplace_back(&postings, ranking.TermWeight(postings.size()));
+        }
+    }
+    const auto is_excluded = [this, &query](int document_id) {
+        return std::any_of(query.minus_words.begin(), query.minus_words.end(), [this, document_id](std::string_view word) {
+                    const auto word_it = word_to_document_freqs_.find(word);
+                    return word_it != word_to_document_freqs_.end() && word_it->second.count(document_id) > 0;
+                })
+                || std::any_of(query.minus_phrases.begin(), query.minus_phrases.end(), [this, document_id](const Phrase& phrase) {
+                    return ContainsPhrase(phrase, document_id);
+                });
+    };
+
+    const PredicateFilter accepts(document_attributes_, document_predicate, requirements.front().first);
+    DocumentAttributes::Cursor document(document_attributes_);
+    auto& rarest = requirements.front().second;
+    while (true) {
+        int candidate = std::numeric_limits<int>::max();
+        bool has_candidate = false;
+        for (const PostingCursor& cursor : rarest) {
+            if (!cursor.AtEnd()) {
+                candidate = std::min(candidate, cursor.DocumentId());
+                has_candidate = true;
+            }
+        }
+        if (!has_candidate) {
+            break;
+        }
+        // The first document the other requirements may all contain
+        int next = candidate;
+        for (size_t i = 1; i < requirements.size() && next == candidate; ++i) {
+            int requirement_next = std::numeric_limits<int>::max();
+            bool has_next = false;
+            for (PostingCursor& cursor : requirements[i].second) {
+                if (cursor.AdvanceTo(candidate)) {
+                    requirement_next = std::min(requirement_next, cursor.DocumentId());
+                    has_next = true;
+                }
+            }
+            if (!has_next) {
+                return matched_documents;
+            }
+            if (requirement_next != candidate) {
+                next = requirement_next;
+            }
+        }
+        if (next == candidate) {
+            document.Seek(candidate);
+            if (accepts(document)
+                    && std::all_of(query.plus_phrases.begin(), query.plus_phrases.end(), [this, candidate](const Phrase& phrase) {
+                        return ContainsPhrase(phrase, candidate);
+                    })
+                    && !is_excluded(candidate)) {
+                double relevance = 0.0;
+                for (const auto& [postings, term_weight] : plus_postings) {
+                    if (const auto it = postings->find(candidate); it != postings->end()) {
+                        relevance += ranking.Score(term_weight, it->second, GetDocumentNorm(*norms, document));
+                    }
+                }
+                for (const FuzzyWord& fuzzy_word : query.fuzzy_words) {
+                    double best_relevance = 0.0;
+                    for (const FuzzyTerm& term : fuzzy_word) {
+                        const auto& postings = word_to_document_freqs_.at(term.data);
+                        if (const auto it = postings.find(candidate); it != postings.end()) {
+                            best_relevance = std::max(best_relevance, term.weight * ranking.Score(ranking.TermWeight(postings.size()), it->second, GetDocumentNorm(*norms, document)));
+                        }
+                    }
+                    relevance += best_relevance;
+                }
+                matched_documents.emplace_back(candidate, relevance, document.GetRating());
+            }
+            if (candidate == std::numeric_limits<int>::max()) {
+                break;
+            }
+            ++next;
+        }
+        for (PostingCursor& cursor : rarest) {
+            cursor.AdvanceTo(next);
+        }
+    }
+    return matched_documents;
+}
+
+template <typename RankingPolicy>
+template <typename DocumentPredicate>
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindAllDocumentsByImpacts(const Query& query, DocumentPredicate document_predicate) const {
+    const auto scored_documents = ScoreDocumentsByImpacts(query);
+    const PredicateFilter accepts(document_attributes_, document_predicate, scored_documents.size());
     std::vector<Document> matched_documents;
-    for (const auto[document_id, relevance] : vec_document_to_relevance) {
-        matched_documents.emplace_back(document_id, relevance, documents_.at(document_id).rating);
+    DocumentAttributes::Cursor document(document_attributes_);
+    for (const auto& [document_id, relevance] : scored_documents) {
+        document.Seek(document_id);
+        if (accepts(document)) {
+            matched_documents.emplace_back(document_id, relevance, document.GetRating());
+        }
     }
     return matched_documents;
 }
 
+template <typename RankingPolicy>
+template <typename Iterator, typename DocumentPredicate>
+FacetedSearchResult BasicSearchServer<RankingPolicy>::CollectFacetedDocuments(Iterator first, Iterator last, DocumentPredicate document_predicate) const {
+    FacetedSearchResult result;
+    DocumentAttributes::Cursor document(document_attributes_);
+    for (; first != last; ++first) {
+        const auto [document_id, relevance] = *first;
+        document.Seek(document_id);
+        const DocumentStatus status = document.GetStatus();
+        const int rating = document.GetRating();
+        result.facets.Add(status, rating);
+        if (document_predicate(document_id, status, rating)) {
+            result.documents.emplace_back(document_id, relevance, rating);
+        }
+    }
+    return result;
+}
+
+template <typename RankingPolicy>
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<Document> BasicSearchServer<RankingPolicy>::FindTopDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
     return FindTopDocuments(raw_query, document_predicate);
 }
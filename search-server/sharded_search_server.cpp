@@ -0,0 +1,82 @@
+#include "sharded_search_server.h"
+
+using namespace std;
+
+size_t GetShardIndex(int document_id, size_t shard_count) {
+    // Fibonacci hashing spreads consecutive ids over all shards
+    const uint64_t hash = static_cast<uint64_t>(document_id) * 11400714819323198485ull;
+    return static_cast<size_t>((hash >> 32) % shard_count);
+}
+
+ShardedSearchServer::ShardedSearchServer(string_view stop_words_text, size_t shard_count, const IndexOptions& options) {
+    if (shard_count == 0) {
+        throw invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words_text, options);
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    if (document_id < 0) {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    shards_[GetShardIndex(document_id, shards_.size())].AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    if (document_id < 0) {
+        return;
+    }
+    shards_[GetShardIndex(document_id, shards_.size())].RemoveDocument(document_id);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    if (document_id < 0) {
+        throw invalid_argument("document with this id doesn't exist"s);
+    }
+    return shards_[GetShardIndex(document_id, shards_.size())].MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+CollectionStatistics ShardedSearchServer::CollectStatistics(string_view raw_query) const {
+    vector<CollectionStatistics> shard_statistics(shards_.size());
+    transform(execution::par, shards_.begin(), shards_.end(), shard_statistics.begin(), [raw_query](const SearchServer& shard) {
+        return shard.GetQueryStatistics(raw_query);
+    });
+    return MergeStatistics(shard_statistics);
+}
+
+vector<Document> ShardedSearchServer::MergeTopDocuments(vector<vector<Document>> shard_results) {
+    vector<Document> result;
+    for (vector<Document>& documents : shard_results) {
+        move(documents.begin(), documents.end(), back_inserter(result));
+    }
+    sort(result.begin(), result.end(), SearchServer::IsRankedBefore);
+    if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        result.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return result;
+}
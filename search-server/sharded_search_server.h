@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <execution>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "search_server.h"
+#include "document.h"
+
+// Index of the shard owning the document among shard_count shards
+size_t GetShardIndex(int document_id, size_t shard_count);
+
+// Splits documents across independent SearchServer shards by a hash of their id. Queries run on all shards
+// concurrently with document frequencies aggregated over the whole collection, so the merged results
+// rank as a single SearchServer holding every document would rank them.
+class ShardedSearchServer {
+public:
+    ShardedSearchServer(std::string_view stop_words_text, size_t shard_count, const IndexOptions& options = {});
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const;
+
+private:
+    std::vector<SearchServer> shards_;
+
+    CollectionStatistics CollectStatistics(std::string_view raw_query) const;
+
+    static std::vector<Document> MergeTopDocuments(std::vector<std::vector<Document>> shard_results);
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    const CollectionStatistics collection = CollectStatistics(raw_query);
+    std::vector<std::vector<Document>> shard_results(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(), shard_results.begin(), [&](const SearchServer& shard) {
+        return shard.FindTopDocuments(raw_query, document_predicate, collection);
+    });
+    return MergeTopDocuments(std::move(shard_results));
+}
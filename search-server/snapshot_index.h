@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "epoch_reclaimer.h"
+#include "layered_index.h"
+
+// Publishes immutable versions of an index, such as SearchServer, for lock-free concurrent reads.
+// Readers pin the current version, writers copy it, modify the copy and publish it atomically,
+// and a replaced version is deleted once no reader holds it anymore.
+// A version is a LayeredIndex sharing its base with the versions before it, so a write copies only the
+// documents written since the base was built; once they exceed max_delta_size, the write folds them into
+// a new base, the only time the whole index is copied.
+template <typename Index>
+class SnapshotIndex {
+public:
+    using Version = LayeredIndex<Index>;
+
+    // Read-only view of one version, valid while the snapshot lives
+    class Snapshot {
+    public:
+        const Version& operator*() const {
+            return *version_;
+        }
+
+        const Version* operator->() const {
+            return version_;
+        }
+
+    private:
+        friend class SnapshotIndex;
+
+        Snapshot(EpochReclaimer::Guard guard, const Version* version)
+                : guard_(std::move(guard))
+                , version_(version) {
+        }
+
+        EpochReclaimer::Guard guard_;
+        const Version* version_;
+    };
+
+    // The empty index gives the stop words and options of the deltas
+    SnapshotIndex(Index index, Index empty_index, size_t max_delta_size = 1024)
+            : empty_index_(std::move(empty_index))
+            , max_delta_size_(max_delta_size)
+            , current_(new Version(std::move(index), empty_index_)) {
+    }
+
+    SnapshotIndex(const SnapshotIndex&) = delete;
+
+    SnapshotIndex& operator=(const SnapshotIndex&) = delete;
+
+    ~SnapshotIndex() {
+        delete current_.load();
+    }
+
+    Snapshot Pin() const {
+        // The version is loaded only after the epoch is pinned, so it cannot be deleted under the reader
+        EpochReclaimer::Guard guard = reclaimer_.Pin();
+        return Snapshot(std::move(guard), current_.load());
+    }
+
+    // Applies modifier to a copy of the current version and publishes it; nothing is published if modifier throws.
+    // Writers are serialized with each other, never with readers.
+    template <typename Modifier>
+    void Update(Modifier modifier) {
+        std::lock_guard guard(update_mutex_);
+        auto next = std::make_unique<Version>(*current_.load());
+        modifier(*next);
+        if (next->GetDeltaSize() > max_delta_size_) {
+            next = std::make_unique<Version>(next->Compact());
+        }
+        Replace(next.release());
+    }
+
+    // Publishes a whole new index in place of the current version
+    void Publish(Index index) {
+        std::lock_guard guard(update_mutex_);
+        Replace(new Version(std::move(index), empty_index_));
+    }
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+        Update([&](Version& version) {
+            version.AddDocument(document_id, document, status, ratings);
+        });
+    }
+
+    void RemoveDocument(int document_id) {
+        Update([document_id](Version& version) {
+            version.RemoveDocument(document_id);
+        });
+    }
+
+    void RemoveDocuments(const std::vector<int>& document_ids) {
+        Update([&document_ids](Version& version) {
+            version.RemoveDocuments(document_ids);
+        });
+    }
+
+    // Deletes replaced versions whose readers have all left since the last write
+    void Collect() {
+        reclaimer_.Collect();
+    }
+
+    // Replaced versions still held by readers
+    size_t GetRetiredVersionCount() const {
+        return reclaimer_.GetRetiredCount();
+    }
+
+private:
+    const Index empty_index_;
+    const size_t max_delta_size_;
+    mutable EpochReclaimer reclaimer_;
+    std::mutex update_mutex_;
+    std::atomic<const Version*> current_;
+
+    void Replace(const Version* next) {
+        const Version* previous = current_.exchange(next);
+        reclaimer_.Retire([previous] {
+            delete previous;
+        });
+    }
+};
@@ -0,0 +1,135 @@
+#include "term_dictionary.h"
+#include "varint.h"
+
+#include <algorithm>
+
+using namespace std;
+
+TermDictionary::Cursor::Cursor(const TermDictionary& dictionary)
+        : dictionary_(&dictionary)
+{
+    LoadBlock(0);
+}
+
+void TermDictionary::Cursor::LoadBlock(size_t block_index) {
+    block_index_ = block_index;
+    index_in_block_ = 0;
+    if (block_index_ < dictionary_->blocks_.size()) {
+        const Block& block = dictionary_->blocks_[block_index_];
+        value_ = block.first;
+        encoded_ = block.encoded_rest.data();
+    }
+}
+
+void TermDictionary::Cursor::Seek(string_view term) {
+    LoadBlock(dictionary_->FindBlock(term));
+    while (!AtEnd() && Value() < term) {
+        Next();
+    }
+}
+
+void TermDictionary::Cursor::Next() {
+    const Block& block = dictionary_->blocks_[block_index_];
+    if (++index_in_block_ == block.count) {
+        LoadBlock(block_index_ + 1);
+        return;
+    }
+    const char* end = block.encoded_rest.data() + block.encoded_rest.size();
+    const size_t shared = ReadVarint(encoded_, end);
+    const size_t suffix_size = ReadVarint(encoded_, end);
+    value_.resize(shared);
+    value_.append(encoded_, suffix_size);
+    encoded_ += suffix_size;
+}
+
+bool TermDictionary::Cursor::AtEnd() const {
+    return block_index_ >= dictionary_->blocks_.size();
+}
+
+string_view TermDictionary::Cursor::Value() const {
+    return value_;
+}
+
+bool TermDictionary::Insert(string_view term) {
+    if (blocks_.empty()) {
+        blocks_.push_back({ string(term), {}, 1 });
+        block_bytes_ += GetBlockBytes(blocks_.back());
+        ++term_count_;
+        return true;
+    }
+    const size_t block_index = FindBlock(term);
+    vector<string> terms = DecodeBlock(blocks_[block_index]);
+    const auto it = lower_bound(terms.begin(), terms.end(), term);
+    if (it != terms.end() && *it == term) {
+        return false;
+    }
+    terms.insert(it, string(term));
+    ++term_count_;
+
+    block_bytes_ -= GetBlockBytes(blocks_[block_index]);
+    if (terms.size() <= MAX_BLOCK_SIZE) {
+        blocks_[block_index] = EncodeBlock(terms.begin(), terms.end());
+    }
+    else {
+        const auto middle = terms.begin() + terms.size() / 2;
+        blocks_[block_index] = EncodeBlock(terms.begin(), middle);
+        blocks_.insert(blocks_.begin() + block_index + 1, EncodeBlock(middle, terms.end()));
+        block_bytes_ += GetBlockBytes(blocks_[block_index + 1]);
+    }
+    block_bytes_ += GetBlockBytes(blocks_[block_index]);
+    return true;
+}
+
+bool TermDictionary::Contains(string_view term) const {
+    Cursor cursor(*this);
+    cursor.Seek(term);
+    return !cursor.AtEnd() && cursor.Value() == term;
+}
+
+size_t TermDictionary::size() const {
+    return term_count_;
+}
+
+size_t TermDictionary::ByteSize() const {
+    return blocks_.capacity() * sizeof(Block) + block_bytes_;
+}
+
+size_t TermDictionary::GetBlockBytes(const Block& block) {
+    return block.first.capacity() + block.encoded_rest.capacity();
+}
+
+size_t TermDictionary::FindBlock(string_view term) const {
+    const auto it = upper_bound(blocks_.begin(), blocks_.end(), term, [](string_view lhs, const Block& rhs) {
+        return lhs < rhs.first;
+    });
+    return it == blocks_.begin() ? 0 : static_cast<size_t>(it - blocks_.begin() - 1);
+}
+
+vector<string> TermDictionary::DecodeBlock(const Block& block) {
+    vector<string> terms;
+    terms.reserve(block.count);
+    terms.push_back(block.first);
+    const char* current = block.encoded_rest.data();
+    const char* end = current + block.encoded_rest.size();
+    while (current != end) {
+        const size_t shared = ReadVarint(current, end);
+        const size_t suffix_size = ReadVarint(current, end);
+        string term = terms.back().substr(0, shared);
+        term.append(current, suffix_size);
+        current += suffix_size;
+        terms.push_back(move(term));
+    }
+    return terms;
+}
+
+TermDictionary::Block TermDictionary::EncodeBlock(vector<string>::const_iterator begin, vector<string>::const_iterator end) {
+    Block block{ *begin, {}, static_cast<uint32_t>(end - begin) };
+    for (auto previous = begin, it = next(begin); it != end; previous = it++) {
+        const size_t shared = mismatch(previous->begin(), previous->end(), it->begin(), it->end()).first - previous->begin();
+        AppendVarint(block.encoded_rest, shared);
+        AppendVarint(block.encoded_rest, it->size() - shared);
+        block.encoded_rest.append(*it, shared, string::npos);
+    }
+    block.encoded_rest.shrink_to_fit();
+    return block;
+}
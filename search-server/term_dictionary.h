@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Sorted set of index terms stored in front-coded blocks: the first term of every block is kept whole,
+// each following one as the length of the prefix shared with its predecessor plus the remaining suffix
+class TermDictionary {
+public:
+    class Cursor {
+    public:
+        explicit Cursor(const TermDictionary& dictionary);
+
+        // Positions the cursor at the first term not less than term
+        void Seek(std::string_view term);
+
+        void Next();
+
+        bool AtEnd() const;
+
+        std::string_view Value() const;
+
+    private:
+        const TermDictionary* dictionary_;
+        size_t block_index_ = 0;
+        size_t index_in_block_ = 0;
+        const char* encoded_ = nullptr;
+        std::string value_;
+
+        void LoadBlock(size_t block_index);
+    };
+
+    // Returns false if the term is already present
+    bool Insert(std::string_view term);
+
+    bool Contains(std::string_view term) const;
+
+    size_t size() const;
+
+    size_t ByteSize() const;
+
+private:
+    struct Block {
+        std::string first;
+        std::string encoded_rest;
+        uint32_t count = 1;
+    };
+
+    static const size_t MAX_BLOCK_SIZE = 32;
+
+    std::vector<Block> blocks_;
+    size_t term_count_ = 0;
+    // Heap bytes of the block strings, kept up to date by Insert
+    size_t block_bytes_ = 0;
+
+    static size_t GetBlockBytes(const Block& block);
+
+    // Index of the block that may contain term
+    size_t FindBlock(std::string_view term) const;
+
+    static std::vector<std::string> DecodeBlock(const Block& block);
+
+    static Block EncodeBlock(std::vector<std::string>::const_iterator begin, std::vector<std::string>::const_iterator end);
+};
@@ -0,0 +1,197 @@
+#include "../bulk_loader.h"
+#include "../test_framework.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// A fresh directory, removed with everything in it
+class TemporaryDirectory {
+public:
+    TemporaryDirectory() {
+        string path_template = (filesystem::temp_directory_path() / "bulk_loader_test-XXXXXX"s).string();
+        if (mkdtemp(path_template.data()) == nullptr) {
+            throw runtime_error("Cannot create a temporary directory"s);
+        }
+        path_ = path_template;
+    }
+
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+    ~TemporaryDirectory() {
+        error_code error;
+        filesystem::remove_all(path_, error);
+    }
+
+    const string& GetPath() const {
+        return path_;
+    }
+
+private:
+    string path_;
+};
+
+struct LoadedRecord {
+    int id;
+    DocumentStatus status;
+    vector<int> ratings;
+    string text;
+};
+
+string WriteFile(const TemporaryDirectory& directory, const string& name, const string& contents) {
+    const string path = directory.GetPath() + "/"s + name;
+    ofstream(path, ios::binary) << contents;
+    return path;
+}
+
+vector<LoadedRecord> LoadRecords(const string& path, CorpusFormat format, size_t chunk_size) {
+    BulkLoadOptions options;
+    options.format = format;
+    options.chunk_size = chunk_size;
+    options.chunks_in_flight = 3;
+    vector<LoadedRecord> records;
+    ForEachRecordBatch(path, options, [&records](const vector<CorpusRecord>& batch) {
+        for (const CorpusRecord& record : batch) {
+            records.push_back({ record.id, record.status, record.ratings, string(record.text) });
+        }
+    });
+    return records;
+}
+
+// Error message of loading the file, empty if it loads
+string GetLoadError(const string& path, CorpusFormat format, size_t chunk_size) {
+    try {
+        LoadRecords(path, format, chunk_size);
+    }
+    catch (const invalid_argument& e) {
+        return e.what();
+    }
+    return {};
+}
+
+string MakeText(int id) {
+    return "document number "s + to_string(id) + (id % 3 == 0 ? " with a longer text than most"s : ""s);
+}
+
+// Every third line ends with CRLF, and blank lines are in between
+string MakeTsvCorpus(int record_count) {
+    string corpus;
+    for (int id = 1; id <= record_count; ++id) {
+        corpus += to_string(id) + "\t"s + (id % 2 == 0 ? "BANNED"s : "ACTUAL"s) + "\t"s;
+        corpus += id % 4 == 0 ? ""s : to_string(id) + ","s + to_string(-id);
+        corpus += "\t"s + MakeText(id) + (id % 3 == 0 ? "\r\n"s : "\n"s);
+        if (id % 5 == 0) {
+            corpus += "\n"s;
+        }
+    }
+    return corpus;
+}
+
+string MakeJsonCorpus(int record_count) {
+    string corpus;
+    for (int id = 1; id <= record_count; ++id) {
+        corpus += "{\"id\": "s + to_string(id) + ", \"status\": \""s + (id % 2 == 0 ? "BANNED"s : "ACTUAL"s) + "\", \"ratings\": ["s;
+        corpus += id % 4 == 0 ? ""s : to_string(id) + ", "s + to_string(-id);
+        corpus += "], \"text\": \""s + MakeText(id) + "\"}"s + (id % 3 == 0 ? "\r\n"s : "\n"s);
+        if (id % 5 == 0) {
+            corpus += "\r\n"s;
+        }
+    }
+    return corpus;
+}
+
+void CheckRecords(const vector<LoadedRecord>& records, int record_count) {
+    ASSERT_EQUAL(records.size(), static_cast<size_t>(record_count));
+    for (int id = 1; id <= record_count; ++id) {
+        const LoadedRecord& record = records[id - 1];
+        ASSERT_EQUAL(record.id, id);
+        ASSERT(record.status == (id % 2 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL));
+        const vector<int> ratings = id % 4 == 0 ? vector<int>{} : vector<int>{ id, -id };
+        ASSERT_EQUAL(record.ratings, ratings);
+        ASSERT_EQUAL(record.text, MakeText(id));
+    }
+}
+
+void TestChunksSmallerThanRecords() {
+    TemporaryDirectory directory;
+    const int RECORD_COUNT = 40;
+    const string tsv_path = WriteFile(directory, "corpus.tsv"s, MakeTsvCorpus(RECORD_COUNT));
+    const string json_path = WriteFile(directory, "corpus.jsonl"s, MakeJsonCorpus(RECORD_COUNT));
+    for (const size_t chunk_size : { 1, 10, 100, 1 << 20 }) {
+        CheckRecords(LoadRecords(tsv_path, CorpusFormat::TSV, chunk_size), RECORD_COUNT);
+        CheckRecords(LoadRecords(json_path, CorpusFormat::JSONL, chunk_size), RECORD_COUNT);
+    }
+    // Without a line break at the end
+    const string last_line_path = WriteFile(directory, "last_line.tsv"s, "1\tACTUAL\t\tcat\n2\tACTUAL\t\tdog"s);
+    ASSERT_EQUAL(LoadRecords(last_line_path, CorpusFormat::TSV, 1).back().text, "dog"s);
+}
+
+void TestErrorNamesLine() {
+    TemporaryDirectory directory;
+    // The blank lines count too, the malformed records are on line 14 of the files
+    string tsv = MakeTsvCorpus(10);
+    ASSERT_EQUAL(count(tsv.begin(), tsv.end(), '\n'), 12);
+    tsv += "13\tACTUAL\t1\tfine\n"s + "x\tACTUAL\t1\tbad id\n"s + "15\tACTUAL\t1\tfine\n"s;
+    const string tsv_path = WriteFile(directory, "corpus.tsv"s, tsv);
+    string json = MakeJsonCorpus(10);
+    json += "{\"id\": 13, \"text\": \"fine\"}\n"s + "{\"id\": 14, \"text\": \"bad\", \"color\": 1}\n"s;
+    const string json_path = WriteFile(directory, "corpus.jsonl"s, json);
+    for (const size_t chunk_size : { 1, 50, 1 << 20 }) {
+        const string tsv_error = GetLoadError(tsv_path, CorpusFormat::TSV, chunk_size);
+        ASSERT(tsv_error.find(", line 14: "s) != string::npos);
+        const string json_error = GetLoadError(json_path, CorpusFormat::JSONL, chunk_size);
+        ASSERT(json_error.find(", line 14: Unknown JSON field color"s) != string::npos);
+    }
+    const string fields_path = WriteFile(directory, "fields.tsv"s, "1\tACTUAL\t\tcat\r\n2\tACTUAL\r\n"s);
+    ASSERT(GetLoadError(fields_path, CorpusFormat::TSV, 1).find(", line 2: TSV record must have 4 fields"s) != string::npos);
+}
+
+void TestJsonEscapes() {
+    const CorpusRecord escaped = ParseJsonRecord(R"({"id": 1, "text": "a\"b\\c\/d\ne\tf"})"s);
+    ASSERT_EQUAL(escaped.unescaped_text, "a\"b\\c/d e f"s);
+    // U+1F600 as a surrogate pair, and U+00E9
+    ASSERT_EQUAL(ParseJsonRecord(R"({"id": 1, "text": "\ud83d\ude00 caf\u00e9"})"s).unescaped_text, "\xF0\x9F\x98\x80 caf\xC3\xA9"s);
+    // Unpaired surrogates become U+FFFD
+    ASSERT_EQUAL(ParseJsonRecord(R"({"id": 1, "text": "\ud83d x"})"s).unescaped_text, "\xEF\xBF\xBD x"s);
+    ASSERT_EQUAL(ParseJsonRecord(R"({"id": 1, "text": "\ude00\ud83d"})"s).unescaped_text, "\xEF\xBF\xBD\xEF\xBF\xBD"s);
+    ASSERT_EQUAL(ParseJsonRecord(R"({"id": 1, "text": "\ud83dA"})"s).unescaped_text, "\xEF\xBF\xBD" "A"s);
+    ASSERT_THROWS(ParseJsonRecord(R"({"id": 1, "text": "\u12"})"s), invalid_argument);
+    ASSERT_THROWS(ParseJsonRecord(R"({"id": 1, "text": "\ud83d\u12"})"s), invalid_argument);
+
+    // The loaded text views the unescaped copy
+    TemporaryDirectory directory;
+    const string path = WriteFile(directory, "corpus.jsonl"s, R"({"id": 1, "text": "\ud83d\ude00 smile"})"s + "\n"s);
+    ASSERT_EQUAL(LoadRecords(path, CorpusFormat::JSONL, 1).front().text, "\xF0\x9F\x98\x80 smile"s);
+}
+
+void TestEmptyRatings() {
+    ASSERT(ParseTsvRecord("1\tACTUAL\t\tcat"s).ratings.empty());
+    ASSERT_EQUAL(ParseTsvRecord("1\tACTUAL\t\t"s).text, ""s);
+    ASSERT(ParseJsonRecord(R"({"id": 1, "ratings": [], "text": "cat"})"s).ratings.empty());
+    ASSERT(ParseJsonRecord(R"({"id": 1, "ratings": [ ], "text": "cat"})"s).ratings.empty());
+    ASSERT(ParseJsonRecord(R"({"id": 1, "text": "cat"})"s).ratings.empty());
+}
+
+}
+
+// Usage: bulk_loader_test
+// Checks that corpus files load the same whatever the chunk size, with CRLF and blank lines, that errors name
+// the line of the file, and the JSON escapes and empty ratings of records.
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestChunksSmallerThanRecords);
+    RUN_TEST(tr, TestErrorNamesLine);
+    RUN_TEST(tr, TestJsonEscapes);
+    RUN_TEST(tr, TestEmptyRatings);
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include "../distributed_search.h"
+#include "../search_server.h"
+#include "../sharded_search_server.h"
+#include "../test_framework.h"
+
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const string STOP_WORDS = "and in on"s;
+const size_t SHARD_COUNT = 3;
+
+const vector<string> QUERIES = {
+    "cat"s, "curly dog -collar"s, "white cat and fancy collar"s, "pigeon in the city"s, "sparrow"s,
+};
+
+string MakeText(int document_id) {
+    static const vector<string> words = {
+        "white"s, "cat"s, "curly"s, "dog"s, "nasty"s, "pigeon"s, "fancy"s, "collar"s, "in"s, "city"s, "the"s,
+    };
+    string text;
+    for (int i = 0; i < 3 + document_id % 5; ++i) {
+        text += words[(document_id * (i + 3) + i) % words.size()] + " "s;
+    }
+    return text;
+}
+
+// Shard processes on sockets of a fresh directory, killed and reaped with it unless they exited
+class ShardProcesses {
+public:
+    ShardProcesses() {
+        string path_template = (filesystem::temp_directory_path() / "distributed_search_test-XXXXXX"s).string();
+        if (mkdtemp(path_template.data()) == nullptr) {
+            throw runtime_error("Cannot create a temporary directory"s);
+        }
+        directory_ = path_template;
+        for (size_t i = 0; i < SHARD_COUNT; ++i) {
+            paths_.push_back(directory_ + "/shard-"s + to_string(i) + ".sock"s);
+            pids_.push_back(SpawnShardProcess(paths_.back(), STOP_WORDS));
+        }
+    }
+
+    ShardProcesses(const ShardProcesses&) = delete;
+
+    ShardProcesses& operator=(const ShardProcesses&) = delete;
+
+    ~ShardProcesses() {
+        for (const pid_t pid : pids_) {
+            if (pid > 0) {
+                kill(pid, SIGKILL);
+                waitpid(pid, nullptr, 0);
+            }
+        }
+        error_code error;
+        filesystem::remove_all(directory_, error);
+    }
+
+    const vector<string>& GetPaths() const {
+        return paths_;
+    }
+
+    pid_t GetPid(size_t shard_index) const {
+        return pids_[shard_index];
+    }
+
+    // Waits for the shard process to exit, returns its wait status
+    int Wait(size_t shard_index) {
+        int status = 0;
+        if (waitpid(pids_[shard_index], &status, 0) != pids_[shard_index]) {
+            throw runtime_error("waitpid: "s + strerror(errno));
+        }
+        pids_[shard_index] = 0;
+        return status;
+    }
+
+private:
+    string directory_;
+    vector<string> paths_;
+    vector<pid_t> pids_;
+};
+
+int ConnectTo(const string& path) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        throw runtime_error("Cannot connect to "s + path);
+    }
+    return fd;
+}
+
+void CheckSameResults(SearchBroker& broker, const SearchServer& search_server) {
+    for (const string& query : QUERIES) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            const DistributedSearchResult result = broker.FindTopDocuments(query, status);
+            const vector<Document> expected = search_server.FindTopDocuments(query, status);
+            ASSERT(result.missing_shards.empty());
+            ASSERT_EQUAL(result.documents.size(), expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL(result.documents[i].id, expected[i].id);
+                ASSERT_EQUAL(result.documents[i].rating, expected[i].rating);
+                ASSERT(abs(result.documents[i].relevance - expected[i].relevance) < 1e-9);
+            }
+        }
+    }
+}
+
+void TestDistributedSearch() {
+    // Forked before this process starts any thread
+    ShardProcesses shards;
+    SearchBroker broker(shards.GetPaths(), chrono::milliseconds(300));
+    SearchServer search_server(STOP_WORDS);
+    for (int document_id = 0; document_id < 90; ++document_id) {
+        const DocumentStatus status = document_id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        const vector<int> ratings = { document_id % 7, -(document_id % 3) };
+        broker.AddDocument(document_id, MakeText(document_id), status, ratings);
+        search_server.AddDocument(document_id, MakeText(document_id), status, ratings);
+    }
+    for (int document_id = 5; document_id < 90; document_id += 11) {
+        broker.RemoveDocument(document_id);
+        search_server.RemoveDocument(document_id);
+    }
+    CheckSameResults(broker, search_server);
+
+    // The shards reply with ERROR, which the broker throws
+    ASSERT_THROWS(broker.FindTopDocuments("cat --dog"s), invalid_argument);
+    ASSERT_THROWS(broker.AddDocument(200, "cat"s, static_cast<DocumentStatus>(200), {}), invalid_argument);
+    ASSERT_THROWS(broker.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {}), invalid_argument);
+
+    // A frame larger than any message closes only its own connection
+    const int fd = ConnectTo(shards.GetPaths()[0]);
+    const uint8_t oversized_header[13] = { 0xff, 0xff, 0xff, 0x7f, static_cast<uint8_t>(MessageType::SEARCH) };
+    ASSERT_EQUAL(write(fd, oversized_header, sizeof(oversized_header)), static_cast<ssize_t>(sizeof(oversized_header)));
+    char byte;
+    ASSERT_EQUAL(read(fd, &byte, 1), 0);
+    close(fd);
+    CheckSameResults(broker, search_server);
+
+    // A shard that stops answering is reported, and the others still answer in time
+    const size_t stopped_shard = 1;
+    kill(shards.GetPid(stopped_shard), SIGSTOP);
+    const auto start = chrono::steady_clock::now();
+    const DistributedSearchResult partial = broker.FindTopDocuments("cat"s);
+    ASSERT(chrono::steady_clock::now() - start < chrono::seconds(2));
+    ASSERT_EQUAL(partial.missing_shards, vector<size_t>{ stopped_shard });
+    ASSERT(!partial.documents.empty());
+    for (const Document& document : partial.documents) {
+        ASSERT(GetShardIndex(document.id, SHARD_COUNT) != stopped_shard);
+    }
+
+    // Its late replies are dropped once it resumes
+    kill(shards.GetPid(stopped_shard), SIGCONT);
+    CheckSameResults(broker, search_server);
+
+    broker.Shutdown();
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        const int status = shards.Wait(i);
+        ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+}
+
+}
+
+// Usage: distributed_search_test
+// Checks that shard processes behind a SearchBroker rank as a single SearchServer, reject malformed requests,
+// and that a stopped shard is reported missing.
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestDistributedSearch);
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include "../document_attributes.h"
+#include "../search_server.h"
+#include "../test_framework.h"
+
+#include <cmath>
+#include <execution>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Predicate = function<bool(int, DocumentStatus, int)>;
+
+// Three blocks of documents with gaps between the ids and removed documents among them.
+// "common" is in every document, "mid" in every third and "rare" in every hundredth.
+SearchServer MakeServer() {
+    SearchServer search_server(""s);
+    for (int i = 0; i < 3000; ++i) {
+        string text = "common"s;
+        if (i % 3 == 0) {
+            text += " mid"s;
+        }
+        if (i % 100 == 0) {
+            text += " rare"s;
+        }
+        text += " filler"s + to_string(i % 17);
+        search_server.AddDocument(2 * i, text, static_cast<DocumentStatus>(i % 3), { i % 10 });
+    }
+    for (int i = 0; i < 3000; i += 7) {
+        search_server.RemoveDocument(2 * i);
+    }
+    return search_server;
+}
+
+const vector<Predicate> PREDICATES = {
+    // Accepting few documents
+    [](int document_id, DocumentStatus status, int) { return document_id % 50 == 0 && status == DocumentStatus::ACTUAL; },
+    // Accepting most documents
+    [](int, DocumentStatus, int rating) { return rating != 3; },
+    [](int, DocumentStatus, int) { return false; },
+};
+
+// Queries scoring few postings, which are filtered per candidate, and many, which are filtered through a bitmap
+const vector<string> QUERIES = { "rare"s, "rare filler4"s, "mid"s, "common"s, "mid rare -filler5"s };
+
+// Every match ranked, filtered by the predicate afterwards
+vector<Document> FindFilteredAfterwards(const SearchServer& search_server, const string& query, const Predicate& predicate) {
+    const auto accepts_all = [](int, DocumentStatus, int) { return true; };
+    vector<Document> documents;
+    for (const Document& document : search_server.FindTopDocumentsAfter(query, numeric_limits<int>::max(), nullopt, accepts_all).documents) {
+        if (predicate(document.id, search_server.GetDocumentStatus(document.id), document.rating)) {
+            documents.push_back(document);
+        }
+    }
+    if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return documents;
+}
+
+void CheckSameDocuments(const vector<Document>& found, const vector<Document>& expected) {
+    ASSERT_EQUAL(found.size(), expected.size());
+    for (size_t i = 0; i < found.size(); ++i) {
+        ASSERT_EQUAL(found[i].id, expected[i].id);
+        ASSERT_EQUAL(found[i].rating, expected[i].rating);
+        ASSERT(abs(found[i].relevance - expected[i].relevance) < 1e-9);
+    }
+}
+
+void TestFilterAgreesWithPredicate() {
+    const SearchServer search_server = MakeServer();
+    DocumentAttributes attributes;
+    for (const int document_id : search_server) {
+        attributes.Add(document_id, search_server.GetDocumentStatus(document_id), document_id % 10, 1);
+    }
+    for (const Predicate& predicate : PREDICATES) {
+        // No candidates calls the predicate per document, as many candidates as documents builds the bitmap
+        const PredicateFilter per_candidate(attributes, predicate, 0);
+        const PredicateFilter bitmap(attributes, predicate, attributes.size());
+        DocumentAttributes::Cursor document(attributes);
+        for (const int document_id : search_server) {
+            document.Seek(document_id);
+            ASSERT_EQUAL(document.GetDocumentId(), document_id);
+            const bool accepted = predicate(document_id, search_server.GetDocumentStatus(document_id), document_id % 10);
+            ASSERT_EQUAL(per_candidate(document), accepted);
+            ASSERT_EQUAL(bitmap(document), accepted);
+        }
+    }
+}
+
+void TestFilteredSearchMatchesPredicate() {
+    const SearchServer search_server = MakeServer();
+    for (const string& query : QUERIES) {
+        for (const Predicate& predicate : PREDICATES) {
+            const vector<Document> expected = FindFilteredAfterwards(search_server, query, predicate);
+            CheckSameDocuments(search_server.FindTopDocuments(query, predicate), expected);
+            CheckSameDocuments(search_server.FindTopDocuments(execution::par, query, predicate), expected);
+        }
+        // Filtering by status goes through a predicate too
+        const Predicate is_banned = [](int, DocumentStatus status, int) { return status == DocumentStatus::BANNED; };
+        CheckSameDocuments(search_server.FindTopDocuments(query, DocumentStatus::BANNED), FindFilteredAfterwards(search_server, query, is_banned));
+    }
+    // The predicates that accept documents accept some of every query
+    for (const string& query : QUERIES) {
+        ASSERT(!search_server.FindTopDocuments(query, PREDICATES[0]).empty());
+        ASSERT(!search_server.FindTopDocuments(query, PREDICATES[1]).empty());
+    }
+}
+
+}
+
+// Usage: document_attributes_test
+// Checks that predicate filters accept the same documents whether they build a bitmap or not, and that filtered
+// searches find the documents the predicate accepts among all matches, for selective and non-selective predicates.
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestFilterAgreesWithPredicate);
+    RUN_TEST(tr, TestFilteredSearchMatchesPredicate);
+    return 0;
+}
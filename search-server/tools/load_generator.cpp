@@ -0,0 +1,185 @@
+#include "../bulk_loader.h"
+#include "../load_generator.h"
+#include "../search_server.h"
+#include "../string_processing.h"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+const size_t MAX_VOCABULARY_SIZE = 100000;
+const size_t SYNTHETIC_VOCABULARY_SIZE = 10000;
+
+const string USAGE =
+    " [--server <port> | --documents <count>] [--corpus <corpus.tsv>] [--queries <query log>]"
+    " [--qps <rate>] [--duration <seconds>] [--concurrency <workers>] [--write-ratio <fraction>]"
+    " [--zipf-exponent <exponent>] [--uniform-arrivals] [--seed <seed>]"s;
+
+// Words of the counts, the most frequent first
+vector<string> RankWords(const unordered_map<string, size_t>& word_counts) {
+    vector<pair<size_t, string>> ranked;
+    ranked.reserve(word_counts.size());
+    for (const auto& [word, count] : word_counts) {
+        ranked.emplace_back(count, word);
+    }
+    sort(ranked.begin(), ranked.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+    });
+    ranked.resize(min(ranked.size(), MAX_VOCABULARY_SIZE));
+    vector<string> words;
+    words.reserve(ranked.size());
+    for (auto& [count, word] : ranked) {
+        words.push_back(move(word));
+    }
+    return words;
+}
+
+vector<LoadRequest> ReadQueryLog(const string& path) {
+    ifstream input(path);
+    if (!input) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    vector<LoadRequest> requests;
+    for (string line; getline(input, line);) {
+        if (line.find_first_not_of(" \r"s) != string::npos) {
+            requests.push_back(ParseLoadRequest(line));
+        }
+    }
+    return requests;
+}
+
+}
+
+// Usage: load_generator [--server <port> | --documents <count>] [--corpus <corpus.tsv>] [--queries <query log>] ...
+// Sends searches, and writes at the write ratio, open-loop at the target rate to a query server (see
+// tools/query_server.cpp), or to an index in this process loaded with the corpus or with Zipfian documents.
+// A query log holds a request of the query server protocol or a bare query per line; without one, queries of
+// Zipfian words of the corpus are sent.
+int main(int argc, char* argv[]) {
+    map<string, string> arguments;
+    for (int i = 1; i < argc; ++i) {
+        const string name = argv[i];
+        if (name == "--uniform-arrivals"s) {
+            arguments[name];
+        }
+        else if (name.compare(0, 2, "--"s) == 0 && i + 1 < argc) {
+            arguments[name] = argv[++i];
+        }
+        else {
+            cerr << "Usage: "s << argv[0] << USAGE << endl;
+            return 1;
+        }
+    }
+    auto get = [&arguments](const string& name, const string& default_value) {
+        const auto it = arguments.find(name);
+        return it == arguments.end() ? default_value : it->second;
+    };
+
+    try {
+        LoadOptions options;
+        options.target_qps = stod(get("--qps"s, "1000"s));
+        options.concurrency = stoul(get("--concurrency"s, "8"s));
+        options.poisson_arrivals = arguments.count("--uniform-arrivals"s) == 0;
+        options.seed = stoull(get("--seed"s, "1"s));
+        const double duration = stod(get("--duration"s, "10"s));
+        const bool is_remote = arguments.count("--server"s) > 0;
+
+        LoadMix mix;
+        mix.write_ratio = stod(get("--write-ratio"s, "0"s));
+        mix.zipf_exponent = stod(get("--zipf-exponent"s, "1"s));
+
+        SearchServer search_server;
+        if (arguments.count("--corpus"s) > 0) {
+            unordered_map<string, size_t> word_counts;
+            size_t document_count = 0;
+            ForEachRecordBatch(arguments.at("--corpus"s), {}, [&](const vector<CorpusRecord>& records) {
+                for (const CorpusRecord& record : records) {
+                    for (const string_view word : SplitIntoWords(record.text)) {
+                        ++word_counts[string(word)];
+                    }
+                    if (!is_remote) {
+                        search_server.AddDocument(record.id, record.text, record.status, record.ratings);
+                    }
+                }
+                document_count += records.size();
+            });
+            mix.vocabulary = RankWords(word_counts);
+            cerr << "Read "s << document_count << " documents, "s << mix.vocabulary.size() << " words"s << endl;
+        }
+        else {
+            for (size_t rank = 0; rank < SYNTHETIC_VOCABULARY_SIZE; ++rank) {
+                mix.vocabulary.push_back("w"s + to_string(rank));
+            }
+            if (!is_remote) {
+                const int document_count = stoi(get("--documents"s, "10000"s));
+                const ZipfDistribution words(mix.vocabulary.size(), mix.zipf_exponent);
+                mt19937_64 generator(options.seed);
+                uniform_int_distribution<int> rating(1, 10);
+                for (int document_id = 0; document_id < document_count; ++document_id) {
+                    string text;
+                    for (size_t i = 0; i < mix.document_words; ++i) {
+                        text += mix.vocabulary[words(generator)];
+                        text += ' ';
+                    }
+                    search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, { rating(generator) });
+                }
+                cerr << "Generated "s << document_count << " documents"s << endl;
+            }
+        }
+
+        const vector<LoadRequest> query_log = arguments.count("--queries"s) > 0 ? ReadQueryLog(arguments.at("--queries"s)) : vector<LoadRequest>{};
+        const vector<LoadRequest> requests = GenerateRequests(query_log, mix, static_cast<size_t>(options.target_qps * duration), options.seed);
+
+        LoadReport report;
+        if (is_remote) {
+            const auto port = static_cast<uint16_t>(stoi(arguments.at("--server"s)));
+            vector<unique_ptr<QueryClient>> clients;
+            for (size_t worker = 0; worker < options.concurrency; ++worker) {
+                clients.push_back(make_unique<QueryClient>(port));
+            }
+            report = RunLoad(requests, options, [&clients](size_t worker, const LoadRequest& request) {
+                clients[worker]->Execute(request);
+            });
+        }
+        else {
+            // Searches run concurrently, a write excludes all other requests like in a server without snapshots
+            shared_mutex mutex;
+            report = RunLoad(requests, options, [&search_server, &mutex](size_t, const LoadRequest& request) {
+                switch (request.type) {
+                    case LoadRequest::Type::SEARCH:
+                    case LoadRequest::Type::SEARCH_ALL: {
+                        shared_lock lock(mutex);
+                        search_server.FindTopDocuments(request.text, request.type == LoadRequest::Type::SEARCH_ALL ? QueryMode::ALL_WORDS : QueryMode::ANY_WORD);
+                        break;
+                    }
+                    case LoadRequest::Type::ADD: {
+                        unique_lock lock(mutex);
+                        search_server.AddDocument(request.document_id, request.text, request.status, request.ratings);
+                        break;
+                    }
+                    case LoadRequest::Type::REMOVE: {
+                        unique_lock lock(mutex);
+                        search_server.RemoveDocument(request.document_id);
+                        break;
+                    }
+                }
+            });
+        }
+        cout << "Target "s << options.target_qps << " requests per second, "s << options.concurrency << " workers"s << endl;
+        PrintLoadReport(cout, report);
+    }
+    catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "../paginator.h"
+#include "../search_server.h"
+#include "../test_framework.h"
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Relevances of documents of about a thousand words differ by less than 1e-6, the relevance rounding of the ranking order
+SearchServer MakeNearTiedServer() {
+    SearchServer search_server(""s);
+    for (int id = 0; id < 300; ++id) {
+        string text = id < 200 ? "cat"s : "dog"s;
+        for (int i = 0; i < 1000 + id % 40; ++i) {
+            text += " filler"s;
+        }
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 5 });
+    }
+    return search_server;
+}
+
+void TestRankingOrderIsStrict() {
+    // Within a tolerance instead, C would rank before B, B before A and A before C
+    const vector<Document> documents = {
+        { 1, 1.2e-6, 0 }, { 2, 0.6e-6, 5 }, { 3, 0.0, 10 }, { 4, 1.0e-6, 5 }, { 5, 0.99e-6, 5 }, { 6, 1.0e-6, 5 },
+    };
+    for (const Document& a : documents) {
+        ASSERT(!SearchServer::IsRankedBefore(a, a));
+        for (const Document& b : documents) {
+            if (a.id != b.id) {
+                ASSERT(SearchServer::IsRankedBefore(a, b) != SearchServer::IsRankedBefore(b, a));
+            }
+            for (const Document& c : documents) {
+                if (SearchServer::IsRankedBefore(a, b) && SearchServer::IsRankedBefore(b, c)) {
+                    ASSERT(SearchServer::IsRankedBefore(a, c));
+                }
+            }
+        }
+    }
+}
+
+void TestPagesHoldEveryMatchOnce() {
+    const SearchServer search_server = MakeNearTiedServer();
+    for (const size_t page_size : { 1, 2, 5, 17, 1000 }) {
+        vector<Document> walked;
+        optional<SearchCursor> after;
+        do {
+            SearchPage page = search_server.FindTopDocumentsAfter("cat"s, page_size, after);
+            ASSERT(page.documents.size() <= page_size);
+            walked.insert(walked.end(), page.documents.begin(), page.documents.end());
+            // A cursor that comes back around would page forever
+            ASSERT(walked.size() <= 200);
+            after = page.next;
+        } while (after);
+
+        map<int, int> counts;
+        for (const Document& document : walked) {
+            ++counts[document.id];
+        }
+        ASSERT_EQUAL(counts.size(), 200u);
+        ASSERT_EQUAL(counts.begin()->first, 0);
+        ASSERT_EQUAL(counts.rbegin()->first, 199);
+        for (const auto& [id, count] : counts) {
+            ASSERT_EQUAL(count, 1);
+        }
+        ASSERT(is_sorted(walked.begin(), walked.end(), SearchServer::IsRankedBefore));
+    }
+}
+
+void TestLazyPagesMatchCursorPages() {
+    const SearchServer search_server = MakeNearTiedServer();
+    vector<int> lazy_ids;
+    for (const vector<Document>& page : PaginateLazily([&search_server](const optional<SearchCursor>& after) {
+        return search_server.FindTopDocumentsAfter("cat"s, 7, after);
+    })) {
+        for (const Document& document : page) {
+            lazy_ids.push_back(document.id);
+        }
+    }
+    vector<int> single_page_ids;
+    for (const Document& document : search_server.FindTopDocumentsAfter("cat"s, 1000).documents) {
+        single_page_ids.push_back(document.id);
+    }
+    ASSERT_EQUAL(lazy_ids, single_page_ids);
+}
+
+}
+
+// Usage: pagination_test
+// Checks that the ranking order is strict and that cursor pages over near-tied relevances hold every match once.
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestRankingOrderIsStrict);
+    RUN_TEST(tr, TestPagesHoldEveryMatchOnce);
+    RUN_TEST(tr, TestLazyPagesMatchCursorPages);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "../bulk_loader.h"
+#include "../query_server.h"
+
+#include <csignal>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+QueryServer* running_server = nullptr;
+
+void HandleSignal(int) {
+    if (running_server != nullptr) {
+        running_server->Stop();
+    }
+}
+
+}
+
+// Usage: query_server <port> [stop words] [corpus.tsv]
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: "s << argv[0] << " <port> [stop words] [corpus.tsv]"s << endl;
+        return 1;
+    }
+    try {
+        SearchServer search_server(argc > 2 ? argv[2] : ""s);
+        if (argc > 3) {
+            cerr << "Loaded "s << LoadCorpus(search_server, argv[3]) << " documents"s << endl;
+        }
+        QueryServer query_server(search_server, static_cast<uint16_t>(stoi(argv[1])));
+        running_server = &query_server;
+        signal(SIGINT, HandleSignal);
+        signal(SIGTERM, HandleSignal);
+        cerr << "Listening on 127.0.0.1:"s << query_server.GetPort() << endl;
+        query_server.Run();
+        running_server = nullptr;
+    }
+    catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include "../load_generator.h"
+#include "../query_server.h"
+#include "../search_server.h"
+#include "../test_framework.h"
+
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// A query server on a free port, running on its own thread until the test ends
+class RunningServer {
+public:
+    explicit RunningServer(SearchServer& search_server)
+            : server_(search_server, 0)
+            , thread_([this] {
+                server_.Run();
+            }) {
+    }
+
+    RunningServer(const RunningServer&) = delete;
+
+    RunningServer& operator=(const RunningServer&) = delete;
+
+    ~RunningServer() {
+        server_.Stop();
+        thread_.join();
+    }
+
+    uint16_t GetPort() const {
+        return server_.GetPort();
+    }
+
+private:
+    QueryServer server_;
+    thread thread_;
+};
+
+// A connection writing the bytes it is given as they are, for what QueryClient never sends
+class RawConnection {
+public:
+    explicit RawConnection(uint16_t port) {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (fd_ < 0 || connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+            throw runtime_error("Cannot connect: "s + strerror(errno));
+        }
+    }
+
+    RawConnection(const RawConnection&) = delete;
+
+    RawConnection& operator=(const RawConnection&) = delete;
+
+    ~RawConnection() {
+        close(fd_);
+    }
+
+    // Returns false once the server closed the connection
+    bool Send(string_view data) {
+        while (!data.empty()) {
+            const ssize_t result = send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+            if (result < 0) {
+                return false;
+            }
+            data.remove_prefix(static_cast<size_t>(result));
+        }
+        return true;
+    }
+
+    // The next lines without their line breaks, fewer if the server closes the connection
+    vector<string> ReadLines(size_t count) {
+        vector<string> lines;
+        while (lines.size() < count) {
+            if (const size_t line_end = input_.find('\n'); line_end != string::npos) {
+                lines.push_back(input_.substr(0, line_end));
+                input_.erase(0, line_end + 1);
+                continue;
+            }
+            char chunk[1 << 16];
+            const ssize_t result = recv(fd_, chunk, sizeof(chunk), 0);
+            if (result <= 0) {
+                break;
+            }
+            input_.append(chunk, static_cast<size_t>(result));
+        }
+        return lines;
+    }
+
+private:
+    int fd_;
+    string input_;
+};
+
+// The response the server sends for the documents, which formats the numbers the same way
+string FormatSearchResponse(const vector<Document>& documents) {
+    string response = "OK"s;
+    for (const Document& document : documents) {
+        char buffer[32];
+        response += ' ' + to_string(document.id) + ':';
+        response.append(buffer, to_chars(buffer, buffer + sizeof(buffer), document.relevance).ptr);
+        response += ':' + to_string(document.rating);
+    }
+    return response;
+}
+
+LoadRequest MakeAdd(int document_id, const string& text, const vector<int>& ratings) {
+    LoadRequest request;
+    request.type = LoadRequest::Type::ADD;
+    request.document_id = document_id;
+    request.text = text;
+    request.ratings = ratings;
+    return request;
+}
+
+LoadRequest MakeSearch(const string& query) {
+    LoadRequest request;
+    request.type = LoadRequest::Type::SEARCH;
+    request.text = query;
+    return request;
+}
+
+void TestClientRequests() {
+    SearchServer search_server("and in"s);
+    RunningServer server(search_server);
+    QueryClient client(server.GetPort());
+
+    ASSERT_EQUAL(client.Execute(MakeAdd(1, "white cat and collar"s, { 3, 5 })), "OK"s);
+    // No ratings are sent as -, which averages to zero
+    ASSERT_EQUAL(client.Execute(MakeAdd(2, "curly dog"s, {})), "OK"s);
+    ASSERT_EQUAL(client.Execute(MakeSearch("dog"s)), FormatSearchResponse(search_server.FindTopDocuments("dog"s)));
+    ASSERT_EQUAL(search_server.FindTopDocuments("dog"s).front().rating, 0);
+    ASSERT_EQUAL(client.Execute(MakeSearch("cat collar"s)), FormatSearchResponse(search_server.FindTopDocuments("cat collar"s)));
+
+    // Answered with ERR, which the client throws; the connection stays usable
+    ASSERT_THROWS(client.Execute(MakeAdd(1, "nasty pigeon"s, {})), runtime_error);
+    ASSERT_THROWS(client.Execute(MakeSearch("cat --dog"s)), runtime_error);
+    LoadRequest remove;
+    remove.type = LoadRequest::Type::REMOVE;
+    remove.document_id = 1;
+    ASSERT_EQUAL(client.Execute(remove), "OK"s);
+    ASSERT_EQUAL(client.Execute(MakeSearch("cat"s)), "OK"s);
+}
+
+void TestPipelinedRequestsAnswerInOrder() {
+    SearchServer search_server(""s);
+    RunningServer server(search_server);
+    RawConnection connection(server.GetPort());
+    // The writes apply between the searches around them, even when they arrive in one batch
+    ASSERT(connection.Send(
+        "ADD 1 ACTUAL 5 cat\n"
+        "SEARCH cat\n"
+        "ADD 2 BANNED - cat dog\r\n"
+        "MATCH 2 cat dog\n"
+        "REMOVE 1\n"
+        "SEARCH cat\n"
+        "\n"
+        "BOGUS 1\n"
+        "ADD x ACTUAL - cat\n"
+        "ADD 3 ACTUAL 1,x cat\n"
+        "MATCH 1 cat\n"
+        "SEARCH   cat\n"sv));
+    const vector<string> lines = connection.ReadLines(11);
+    ASSERT_EQUAL(lines.size(), 11u);
+    ASSERT_EQUAL(lines[0], "OK"s);
+    ASSERT_EQUAL(lines[1].substr(0, 5), "OK 1:"s);
+    ASSERT_EQUAL(lines[1].substr(lines[1].size() - 2), ":5"s);
+    ASSERT_EQUAL(lines[2], "OK"s);
+    ASSERT_EQUAL(lines[3], "OK BANNED cat dog"s);
+    ASSERT_EQUAL(lines[4], "OK"s);
+    // Document 2 is banned, so nothing is left to find
+    ASSERT_EQUAL(lines[5], "OK"s);
+    ASSERT_EQUAL(lines[6], "ERR Unknown command"s);
+    ASSERT_EQUAL(lines[7].substr(0, 4), "ERR "s);
+    ASSERT_EQUAL(lines[8].substr(0, 4), "ERR "s);
+    ASSERT_EQUAL(lines[9].substr(0, 4), "ERR "s);
+    ASSERT_EQUAL(lines[10], "OK"s);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 1);
+}
+
+void TestPartialLinesAndLargeOutput() {
+    SearchServer search_server(""s);
+    for (int document_id = 0; document_id < 20; ++document_id) {
+        search_server.AddDocument(document_id, "cat number"s + to_string(document_id), DocumentStatus::ACTUAL, { document_id });
+    }
+    const string expected = FormatSearchResponse(search_server.FindTopDocuments("cat"s));
+    RunningServer server(search_server);
+    RawConnection connection(server.GetPort());
+
+    // A request split across writes is answered once its line is complete
+    ASSERT(connection.Send("SEA"sv));
+    this_thread::sleep_for(chrono::milliseconds(20));
+    ASSERT(connection.Send("RCH c"sv));
+    this_thread::sleep_for(chrono::milliseconds(20));
+    ASSERT(connection.Send("at\n"sv));
+    ASSERT_EQUAL(connection.ReadLines(1), vector<string>{ expected });
+
+    // More answers than the socket buffers hold, sent before any is read, so the server writes them in parts
+    const size_t REQUEST_COUNT = 20000;
+    string requests;
+    for (size_t i = 0; i < REQUEST_COUNT; ++i) {
+        requests += "SEARCH cat\n"s;
+    }
+    ASSERT(connection.Send(requests));
+    const vector<string> lines = connection.ReadLines(REQUEST_COUNT);
+    ASSERT_EQUAL(lines.size(), REQUEST_COUNT);
+    for (const string& line : lines) {
+        ASSERT_EQUAL(line, expected);
+    }
+}
+
+void TestOverlongLineClosesItsConnection() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    RunningServer server(search_server);
+    QueryClient client(server.GetPort());
+    {
+        RawConnection connection(server.GetPort());
+        // Over the longest line the server buffers, without a line break
+        const string line(2 << 20, 'a');
+        connection.Send(line);
+        ASSERT(connection.ReadLines(1).empty());
+    }
+    ASSERT_EQUAL(client.Execute(MakeSearch("cat"s)), FormatSearchResponse(search_server.FindTopDocuments("cat"s)));
+}
+
+}
+
+// Usage: query_server_test
+// Checks the answers of a QueryServer on the loopback interface: in request order across pipelined writes,
+// ERR for failed and malformed requests, - for no ratings, and responses larger than the socket buffers.
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestClientRequests);
+    RUN_TEST(tr, TestPipelinedRequestsAnswerInOrder);
+    RUN_TEST(tr, TestPartialLinesAndLargeOutput);
+    RUN_TEST(tr, TestOverlongLineClosesItsConnection);
+    return 0;
+}
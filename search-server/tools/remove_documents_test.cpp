@@ -0,0 +1,115 @@
+#include "../search_server.h"
+#include "../test_framework.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const vector<string> QUERIES = { "cat"s, "dog -collar"s, "\"white cat\" pigeon"s, "col*"s, "~doge"s, "sparrow"s };
+
+SearchServer MakeServer() {
+    static const vector<string> words = {
+        "white"s, "cat"s, "curly"s, "dog"s, "collar"s, "nasty"s, "pigeon"s, "big"s, "eyes"s, "sparrow"s,
+    };
+    IndexOptions options;
+    options.store_positions = true;
+    options.store_documents = true;
+    SearchServer search_server("and"s, options);
+    for (int document_id = 0; document_id < 300; ++document_id) {
+        string text;
+        for (int i = 0; i < 2 + document_id % 6; ++i) {
+            text += words[(document_id * 7 + i * (document_id % 4 + 1)) % words.size()] + (i == 2 ? " and "s : " "s);
+        }
+        search_server.AddDocument(document_id, text, static_cast<DocumentStatus>(document_id % 2), { document_id % 9 });
+    }
+    return search_server;
+}
+
+void CheckSameIndexes(const SearchServer& batch, const SearchServer& single) {
+    ASSERT_EQUAL(batch.GetDocumentCount(), single.GetDocumentCount());
+    ASSERT_EQUAL(vector<int>(batch.begin(), batch.end()), vector<int>(single.begin(), single.end()));
+    const MemoryUsage batch_memory = batch.GetMemoryUsage();
+    const MemoryUsage single_memory = single.GetMemoryUsage();
+    ASSERT_EQUAL(batch_memory.lexicon, single_memory.lexicon);
+    ASSERT_EQUAL(batch_memory.postings, single_memory.postings);
+    ASSERT_EQUAL(batch_memory.forward_index, single_memory.forward_index);
+    ASSERT_EQUAL(batch_memory.document_metadata, single_memory.document_metadata);
+    ASSERT_EQUAL(batch_memory.document_store, single_memory.document_store);
+    ASSERT_EQUAL(batch_memory.caches, single_memory.caches);
+
+    for (const string& query : QUERIES) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT }) {
+            const vector<Document> found = batch.FindTopDocuments(query, status);
+            const vector<Document> expected = single.FindTopDocuments(query, status);
+            ASSERT_EQUAL(found.size(), expected.size());
+            for (size_t i = 0; i < found.size(); ++i) {
+                ASSERT_EQUAL(found[i].id, expected[i].id);
+                ASSERT_EQUAL(found[i].rating, expected[i].rating);
+                ASSERT(abs(found[i].relevance - expected[i].relevance) < 1e-12);
+            }
+        }
+    }
+    for (const int document_id : single) {
+        ASSERT_EQUAL(get<0>(batch.MatchDocument("white cat dog"s, document_id)), get<0>(single.MatchDocument("white cat dog"s, document_id)));
+        const WordFrequencies batch_freqs = batch.GetWordFrequencies(document_id);
+        const WordFrequencies single_freqs = single.GetWordFrequencies(document_id);
+        ASSERT(equal(batch_freqs.begin(), batch_freqs.end(), single_freqs.begin(), single_freqs.end()));
+    }
+}
+
+void CheckBatchMatchesSingleRemovals(const SearchServer& base, const vector<int>& document_ids) {
+    SearchServer batch(base);
+    SearchServer single(base);
+    batch.RemoveDocuments(document_ids);
+    for (const int document_id : document_ids) {
+        single.RemoveDocument(document_id);
+    }
+    CheckSameIndexes(batch, single);
+}
+
+void TestBatchMatchesSingleRemovals() {
+    const SearchServer base = MakeServer();
+    vector<int> every_third;
+    for (int document_id = 0; document_id < 300; document_id += 3) {
+        every_third.push_back(document_id);
+    }
+    CheckBatchMatchesSingleRemovals(base, every_third);
+    // Unknown and repeated ids are ignored, in any order
+    CheckBatchMatchesSingleRemovals(base, { 17, -1, 5, 17, 1000, 5, 299, 0, 299 });
+    CheckBatchMatchesSingleRemovals(base, { -5, 300, 12345 });
+    CheckBatchMatchesSingleRemovals(base, {});
+
+    vector<int> all_twice;
+    for (int document_id = 299; document_id >= 0; --document_id) {
+        all_twice.push_back(document_id);
+        all_twice.push_back(document_id);
+    }
+    CheckBatchMatchesSingleRemovals(base, all_twice);
+}
+
+void TestBatchAfterQueriesAndSealing() {
+    SearchServer base = MakeServer();
+    base.SealImpacts(ImpactPrecision::BITS_8);
+    // Warm the caches, which the removals must invalidate alike
+    for (const string& query : QUERIES) {
+        base.FindTopDocuments(query);
+    }
+    CheckBatchMatchesSingleRemovals(base, { 1, 2, 3, 1, 250, 251, 999 });
+}
+
+}
+
+// Usage: remove_documents_test
+// Checks that removing documents in a batch leaves the same results and memory statistics as removing them one
+// by one, with unknown and repeated ids among them.
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestBatchMatchesSingleRemovals);
+    RUN_TEST(tr, TestBatchAfterQueriesAndSealing);
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include "../replica_index.h"
+#include "../search_server.h"
+#include "../test_framework.h"
+#include "../write_ahead_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// A fresh directory, removed with everything in it
+class TemporaryDirectory {
+public:
+    TemporaryDirectory() {
+        string path_template = (filesystem::temp_directory_path() / "replica_index_test-XXXXXX"s).string();
+        if (mkdtemp(path_template.data()) == nullptr) {
+            throw runtime_error("Cannot create a temporary directory"s);
+        }
+        path_ = path_template;
+    }
+
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+    ~TemporaryDirectory() {
+        error_code error;
+        filesystem::remove_all(path_, error);
+    }
+
+    const string& GetPath() const {
+        return path_;
+    }
+
+private:
+    string path_;
+};
+
+const vector<string> QUERIES = { "cat"s, "dog -white"s, "white cat collar"s, "pigeon"s };
+
+IndexOptions MakeStoringOptions() {
+    IndexOptions options;
+    options.store_documents = true;
+    return options;
+}
+
+string MakeText(int document_id) {
+    static const vector<string> words = { "white"s, "cat"s, "curly"s, "dog"s, "nasty"s, "pigeon"s, "collar"s };
+    return words[document_id % 7] + " "s + words[document_id * 3 % 7] + " "s + words[document_id * 5 % 4];
+}
+
+// The updates of the writers, numbered by their log sequence from 1
+template <typename Index>
+void ApplyUpdate(Index& index, int update) {
+    if (update % 5 == 4) {
+        index.RemoveDocument(update - 3);
+    } else {
+        index.AddDocument(update, MakeText(update), DocumentStatus::ACTUAL, { update % 10 });
+    }
+}
+
+vector<filesystem::path> ListSegments(const string& directory) {
+    vector<filesystem::path> segments;
+    for (const auto& entry : filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".log"s) {
+            segments.push_back(entry.path());
+        }
+    }
+    sort(segments.begin(), segments.end());
+    return segments;
+}
+
+template <typename Index>
+void CheckSameResults(const ReplicaIndex<Index>& replica, const Index& expected) {
+    const auto snapshot = replica.Pin();
+    ASSERT_EQUAL(snapshot->GetDocumentCount(), expected.GetDocumentCount());
+    for (const string& query : QUERIES) {
+        const vector<Document> found = snapshot->FindTopDocuments(query);
+        const vector<Document> reference = expected.FindTopDocuments(query);
+        ASSERT_EQUAL(found.size(), reference.size());
+        for (size_t i = 0; i < found.size(); ++i) {
+            ASSERT_EQUAL(found[i].id, reference[i].id);
+            ASSERT_EQUAL(found[i].rating, reference[i].rating);
+        }
+    }
+}
+
+void TestFollowsForkedWriter() {
+    const int UPDATE_COUNT = 300;
+    TemporaryDirectory directory;
+    const pid_t writer = fork();
+    ASSERT(writer >= 0);
+    if (writer == 0) {
+        SearchServer search_server(""s, MakeStoringOptions());
+        WriteAheadLogOptions options;
+        options.seal_interval = chrono::milliseconds(100);
+        DurableIndex durable_index(search_server, directory.GetPath(), options);
+        for (int update = 1; update <= UPDATE_COUNT; ++update) {
+            ApplyUpdate(durable_index, update);
+            if (update % 100 == 0) {
+                durable_index.Checkpoint();
+            }
+            this_thread::sleep_for(chrono::milliseconds(5));
+        }
+        durable_index.SealLog();
+        _exit(0);
+    }
+
+    ReplicaOptions options;
+    options.poll_interval = chrono::milliseconds(50);
+    ReplicaIndex replica(SearchServer(""s), directory.GetPath(), options);
+    set<uint64_t> applied_sequences;
+    int status = 0;
+    while (waitpid(writer, &status, WNOHANG) == 0) {
+        applied_sequences.insert(replica.GetAppliedSequence());
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    for (int attempt = 0; attempt < 500 && replica.GetAppliedSequence() < UPDATE_COUNT; ++attempt) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    ASSERT_EQUAL(replica.GetAppliedSequence(), static_cast<uint64_t>(UPDATE_COUNT));
+    // The replica published versions while the writer ran, not only once it was done
+    ASSERT(applied_sequences.size() > 3);
+
+    SearchServer expected(""s);
+    for (int update = 1; update <= UPDATE_COUNT; ++update) {
+        ApplyUpdate(expected, update);
+    }
+    CheckSameResults(replica, expected);
+}
+
+void TestReloadsAfterMissedCheckpoint() {
+    TemporaryDirectory directory;
+    SearchServer search_server(""s, MakeStoringOptions());
+    DurableIndex durable_index(search_server, directory.GetPath());
+    for (int update = 1; update <= 20; ++update) {
+        ApplyUpdate(durable_index, update);
+    }
+    durable_index.SealLog();
+
+    // Polled by hand only
+    ReplicaOptions options;
+    options.poll_interval = chrono::hours(1);
+    ReplicaIndex replica(SearchServer(""s), directory.GetPath(), options);
+    ASSERT_EQUAL(replica.GetAppliedSequence(), 20u);
+    ASSERT(!replica.Poll());
+
+    for (int update = 21; update <= 40; ++update) {
+        ApplyUpdate(durable_index, update);
+    }
+    durable_index.Checkpoint();
+    for (int update = 41; update <= 50; ++update) {
+        ApplyUpdate(durable_index, update);
+    }
+    durable_index.SealLog();
+
+    // The records 21 to 40 are only in the snapshot now
+    ASSERT(replica.Poll());
+    ASSERT_EQUAL(replica.GetAppliedSequence(), 50u);
+    ASSERT_EQUAL(replica.GetFailedPollCount(), 0u);
+    ASSERT(!replica.GetLastError());
+    CheckSameResults(replica, search_server);
+}
+
+void TestFailedPollKeepsVersion() {
+    TemporaryDirectory directory;
+    SearchServer search_server(""s, MakeStoringOptions());
+    DurableIndex durable_index(search_server, directory.GetPath());
+    for (int update = 1; update <= 10; ++update) {
+        ApplyUpdate(durable_index, update);
+    }
+    durable_index.SealLog();
+    ReplicaOptions options;
+    options.poll_interval = chrono::hours(1);
+    ReplicaIndex replica(SearchServer(""s), directory.GetPath(), options);
+    const int document_count = replica.Pin()->GetDocumentCount();
+
+    for (int update = 11; update <= 30; ++update) {
+        ApplyUpdate(durable_index, update);
+        if (update % 10 == 0) {
+            durable_index.SealLog();
+        }
+    }
+    // Without a checkpoint, the records of the segment after the applied ones are lost rather than snapshotted
+    const vector<filesystem::path> segments = ListSegments(directory.GetPath());
+    ASSERT_EQUAL(segments.size(), 4u);
+    filesystem::remove(segments[1]);
+    ASSERT_THROWS(replica.Poll(), runtime_error);
+    ASSERT_THROWS(replica.Poll(), runtime_error);
+    ASSERT_EQUAL(replica.GetFailedPollCount(), 2u);
+    ASSERT(replica.GetLastError().has_value());
+    ASSERT(replica.GetLastError()->find("missing"s) != string::npos);
+    ASSERT_EQUAL(replica.GetAppliedSequence(), 10u);
+    ASSERT_EQUAL(replica.Pin()->GetDocumentCount(), document_count);
+}
+
+}
+
+// Usage: replica_index_test
+// Checks that a ReplicaIndex follows a writer in another process, reloads after a checkpoint it missed, and
+// counts failed polls without changing its version.
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestFollowsForkedWriter);
+    RUN_TEST(tr, TestReloadsAfterMissedCheckpoint);
+    RUN_TEST(tr, TestFailedPollKeepsVersion);
+    return 0;
+}
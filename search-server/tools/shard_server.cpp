@@ -0,0 +1,23 @@
+#include "../distributed_search.h"
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Usage: shard_server <socket path> [stop words]
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: "s << argv[0] << " <socket path> [stop words]"s << endl;
+        return 1;
+    }
+    try {
+        ShardProcess shard(argv[1], argc > 2 ? argv[2] : ""s);
+        shard.Serve();
+    }
+    catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
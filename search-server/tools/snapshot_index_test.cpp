@@ -0,0 +1,128 @@
+#include "../search_server.h"
+#include "../snapshot_index.h"
+#include "../test_framework.h"
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const vector<string> QUERIES = {
+    "w1"s, "w2 w3 -w4"s, "w5 w6 w7 w8"s, "\"w1 w2\" w9"s, "w1*"s, "~w12"s, "w0 w13"s,
+};
+
+string MakeText(mt19937& generator) {
+    string text;
+    for (int i = 0, length = 1 + generator() % 12; i < length; ++i) {
+        text += "w"s + to_string(generator() % 20) + (i % 4 == 3 ? " and "s : " "s);
+    }
+    return text;
+}
+
+template <typename Index>
+void CheckSameResults(const SnapshotIndex<Index>& snapshot_index, const Index& reference) {
+    const auto snapshot = snapshot_index.Pin();
+    ASSERT_EQUAL(snapshot->GetDocumentCount(), reference.GetDocumentCount());
+    for (const string& query : QUERIES) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            const vector<Document> expected = reference.FindTopDocuments(query, status);
+            const vector<Document> found = snapshot->FindTopDocuments(query, status);
+            ASSERT_EQUAL(found.size(), expected.size());
+            for (size_t i = 0; i < found.size(); ++i) {
+                ASSERT_EQUAL(found[i].id, expected[i].id);
+                ASSERT_EQUAL(found[i].rating, expected[i].rating);
+                ASSERT(abs(found[i].relevance - expected[i].relevance) < 1e-9);
+            }
+        }
+    }
+    for (const int document_id : reference) {
+        ASSERT(snapshot->HasDocument(document_id));
+        ASSERT_EQUAL(get<0>(snapshot->MatchDocument("w1 w2 w3"s, document_id)), get<0>(reference.MatchDocument("w1 w2 w3"s, document_id)));
+    }
+}
+
+// Random adds, removals and re-adds of removed ids, in batches, against an index updated in place
+template <typename Index>
+void CheckRandomUpdates(size_t max_delta_size) {
+    IndexOptions options;
+    options.store_positions = true;
+    const Index empty_index("and"s, options);
+    Index reference(empty_index);
+    SnapshotIndex<Index> snapshot_index(empty_index, empty_index, max_delta_size);
+    mt19937 generator(7);
+    for (int batch = 0; batch < 60; ++batch) {
+        vector<pair<int, string>> added;
+        vector<int> removed;
+        for (int i = 0, count = 1 + generator() % 6; i < count; ++i) {
+            const int document_id = generator() % 120;
+            if (reference.HasDocument(document_id)) {
+                reference.RemoveDocument(document_id);
+                removed.push_back(document_id);
+            } else {
+                const string text = MakeText(generator);
+                reference.AddDocument(document_id, text, static_cast<DocumentStatus>(document_id % 3), { document_id % 7 });
+                added.emplace_back(document_id, text);
+            }
+        }
+        // A batch may remove and add the same id, so the updates are replayed in their order
+        snapshot_index.Update([&](typename SnapshotIndex<Index>::Version& version) {
+            version.RemoveDocuments(removed);
+            for (const auto& [document_id, text] : added) {
+                version.AddDocument(document_id, text, static_cast<DocumentStatus>(document_id % 3), { document_id % 7 });
+            }
+        });
+        CheckSameResults(snapshot_index, reference);
+    }
+}
+
+void TestVersionsRankAsOneIndex() {
+    CheckRandomUpdates<SearchServer>(1024);
+    CheckRandomUpdates<SearchServer>(8);
+    CheckRandomUpdates<BasicSearchServer<Bm25Ranking>>(1024);
+    CheckRandomUpdates<BasicSearchServer<Bm25Ranking>>(8);
+}
+
+void TestWritesShareTheBase() {
+    SearchServer base("and"s);
+    for (int document_id = 0; document_id < 100; ++document_id) {
+        base.AddDocument(document_id, "w"s + to_string(document_id % 10), DocumentStatus::ACTUAL, { 1 });
+    }
+    SnapshotIndex<SearchServer> snapshot_index(base, SearchServer("and"s), 4);
+    const auto before = snapshot_index.Pin();
+    snapshot_index.RemoveDocument(5);
+    snapshot_index.AddDocument(100, "w5 w5"s, DocumentStatus::ACTUAL, { 2 });
+    {
+        const auto after = snapshot_index.Pin();
+        ASSERT_EQUAL(&after->GetBase(), &before->GetBase());
+        ASSERT_EQUAL(after->GetDelta().GetDocumentCount(), 1);
+        ASSERT_EQUAL(after->GetDeltaSize(), 2u);
+        ASSERT(!after->HasDocument(5));
+        ASSERT_THROWS(after->MatchDocument("w5"s, 5), out_of_range);
+    }
+    ASSERT_THROWS(snapshot_index.AddDocument(6, "w6"s, DocumentStatus::ACTUAL, {}), invalid_argument);
+    snapshot_index.AddDocument(5, "w5"s, DocumentStatus::ACTUAL, {});
+    snapshot_index.AddDocument(101, "w1"s, DocumentStatus::ACTUAL, {});
+    snapshot_index.AddDocument(102, "w2"s, DocumentStatus::ACTUAL, {});
+
+    // The fifth update exceeds the delta size and is folded into a new base
+    const auto compacted = snapshot_index.Pin();
+    ASSERT(&compacted->GetBase() != &before->GetBase());
+    ASSERT_EQUAL(compacted->GetDeltaSize(), 0u);
+    ASSERT_EQUAL(compacted->GetBase().GetDocumentCount(), 103);
+    ASSERT_EQUAL(before->GetDocumentCount(), 100);
+}
+
+}
+
+// Usage: snapshot_index_test
+// Checks that versions published by SnapshotIndex share their base and rank as an index updated in place.
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestVersionsRankAsOneIndex);
+    RUN_TEST(tr, TestWritesShareTheBase);
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include "../search_server.h"
+#include "../test_framework.h"
+#include "../write_ahead_log.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+using namespace std;
+
+namespace {
+
+// A fresh directory, removed with everything in it
+class TemporaryDirectory {
+public:
+    TemporaryDirectory() {
+        string path_template = (filesystem::temp_directory_path() / "write_ahead_log_test-XXXXXX"s).string();
+        if (mkdtemp(path_template.data()) == nullptr) {
+            throw runtime_error("Cannot create a temporary directory"s);
+        }
+        path_ = path_template;
+    }
+
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+    ~TemporaryDirectory() {
+        error_code error;
+        filesystem::remove_all(path_, error);
+    }
+
+    const string& GetPath() const {
+        return path_;
+    }
+
+private:
+    string path_;
+};
+
+IndexOptions MakeStoringOptions() {
+    IndexOptions options;
+    options.store_documents = true;
+    return options;
+}
+
+// Texts of the documents of the index by id
+map<int, string> GetDocuments(const SearchServer& search_server) {
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    map<int, string> documents;
+    for (const StoredDocument& document : search_server.GetStoredDocuments(document_ids)) {
+        documents[document.id] = document.text;
+    }
+    return documents;
+}
+
+map<int, string> RecoverDocuments(const string& directory) {
+    SearchServer search_server(""s, MakeStoringOptions());
+    RecoverIndex(search_server, directory);
+    return GetDocuments(search_server);
+}
+
+vector<filesystem::path> ListSegments(const string& directory) {
+    vector<filesystem::path> segments;
+    for (const auto& entry : filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".log"s) {
+            segments.push_back(entry.path());
+        }
+    }
+    sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void TestReplayCutsTornRecord() {
+    TemporaryDirectory directory;
+    uintmax_t intact_size = 0;
+    {
+        SearchServer search_server(""s, MakeStoringOptions());
+        DurableIndex durable_index(search_server, directory.GetPath());
+        durable_index.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+        durable_index.AddDocument(2, "curly dog"s, DocumentStatus::ACTUAL, { 2 });
+        intact_size = filesystem::file_size(ListSegments(directory.GetPath()).back());
+        durable_index.AddDocument(3, "nasty pigeon"s, DocumentStatus::ACTUAL, { 3 });
+    }
+    // A crash in the middle of writing the last record leaves only part of it
+    const filesystem::path segment = ListSegments(directory.GetPath()).back();
+    filesystem::resize_file(segment, filesystem::file_size(segment) - 3);
+
+    const map<int, string> expected = { { 1, "white cat"s }, { 2, "curly dog"s } };
+    ASSERT_EQUAL(RecoverDocuments(directory.GetPath()), expected);
+    ASSERT_EQUAL(filesystem::file_size(segment), intact_size);
+
+    // The log continues after the cut record, whose sequence is reused
+    {
+        SearchServer search_server(""s, MakeStoringOptions());
+        DurableIndex durable_index(search_server, directory.GetPath());
+        ASSERT_EQUAL(GetDocuments(search_server), expected);
+        durable_index.AddDocument(4, "big eyes"s, DocumentStatus::ACTUAL, { 4 });
+    }
+    const map<int, string> continued = { { 1, "white cat"s }, { 2, "curly dog"s }, { 4, "big eyes"s } };
+    ASSERT_EQUAL(RecoverDocuments(directory.GetPath()), continued);
+}
+
+void TestRecoveryFromCheckpoint() {
+    TemporaryDirectory directory;
+    {
+        SearchServer search_server(""s, MakeStoringOptions());
+        DurableIndex durable_index(search_server, directory.GetPath());
+        durable_index.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+        durable_index.AddDocument(2, "curly dog"s, DocumentStatus::BANNED, {});
+        durable_index.AddDocument(3, "nasty pigeon"s, DocumentStatus::ACTUAL, { 3 });
+        durable_index.Checkpoint();
+        // Only the segment started by the checkpoint is left, the records before it are in the snapshot
+        ASSERT_EQUAL(ListSegments(directory.GetPath()).size(), 1u);
+        ASSERT(FindLatestSnapshot(directory.GetPath()).has_value());
+        durable_index.RemoveDocument(1);
+        durable_index.AddDocument(4, "big eyes"s, DocumentStatus::ACTUAL, { 4 });
+    }
+
+    SearchServer search_server(""s, MakeStoringOptions());
+    RecoverIndex(search_server, directory.GetPath());
+    const map<int, string> expected = { { 2, "curly dog"s }, { 3, "nasty pigeon"s }, { 4, "big eyes"s } };
+    ASSERT_EQUAL(GetDocuments(search_server), expected);
+    ASSERT(search_server.GetDocumentStatus(2) == DocumentStatus::BANNED);
+    ASSERT_EQUAL(search_server.GetStoredDocuments(vector<int>{ 3 }).front().ratings, vector<int>{ 3 });
+}
+
+void TestLogFailureLeavesIndexReadOnly() {
+    TemporaryDirectory directory;
+    SearchServer search_server(""s, MakeStoringOptions());
+    DurableIndex durable_index(search_server, directory.GetPath());
+    durable_index.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+
+    // Writes past the file size limit fail with EFBIG instead of raising SIGXFSZ
+    const auto previous_handler = signal(SIGXFSZ, SIG_IGN);
+    rlimit previous_limit;
+    getrlimit(RLIMIT_FSIZE, &previous_limit);
+    rlimit limit = previous_limit;
+    limit.rlim_cur = filesystem::file_size(ListSegments(directory.GetPath()).back()) + 16;
+    setrlimit(RLIMIT_FSIZE, &limit);
+    ASSERT_THROWS(durable_index.AddDocument(2, string(1024, 'a'), DocumentStatus::ACTUAL, { 2 }), runtime_error);
+    setrlimit(RLIMIT_FSIZE, &previous_limit);
+    signal(SIGXFSZ, previous_handler);
+
+    ASSERT(durable_index.IsFailed());
+    ASSERT_THROWS(durable_index.AddDocument(3, "curly dog"s, DocumentStatus::ACTUAL, { 3 }), runtime_error);
+    ASSERT_THROWS(durable_index.RemoveDocument(1), runtime_error);
+    ASSERT_THROWS(durable_index.Checkpoint(), runtime_error);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+    // The update that was never acknowledged is not recovered
+    const map<int, string> expected = { { 1, "white cat"s } };
+    ASSERT_EQUAL(RecoverDocuments(directory.GetPath()), expected);
+}
+
+}
+
+// Usage: write_ahead_log_test
+// Checks recovery of a DurableIndex from a torn log and from a checkpoint, and its read-only state after
+// writing the log failed.
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestReplayCutsTornRecord);
+    RUN_TEST(tr, TestRecoveryFromCheckpoint);
+    RUN_TEST(tr, TestLogFailureLeavesIndexReadOnly);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "top_documents_cache.h"
+
+#include "memory_usage.h"
+
+using namespace std;
+
+shared_ptr<const TopDocumentsCache::Entry> TopDocumentsCache::Find(string_view term) const {
+    lock_guard guard(mutex_);
+    DropIfStale();
+    const auto it = entries_.find(term);
+    return it == entries_.end() ? nullptr : it->second;
+}
+
+void TopDocumentsCache::Insert(string_view term, shared_ptr<const Entry> entry) const {
+    lock_guard guard(mutex_);
+    DropIfStale();
+    size_t entry_bytes = TREE_NODE_OVERHEAD + sizeof(pair<const string, shared_ptr<const Entry>>) + GetAllocationBytes(term.size() + 1) + GetAllocationBytes(sizeof(Entry));
+    for (const vector<Document>& documents : *entry) {
+        entry_bytes += documents.capacity() * sizeof(Document);
+    }
+    if (entries_.insert_or_assign(string(term), move(entry)).second) {
+        byte_size_ += entry_bytes;
+    }
+}
+
+void TopDocumentsCache::Invalidate() {
+    lock_guard guard(mutex_);
+    is_stale_ = true;
+}
+
+size_t TopDocumentsCache::ByteSize() const {
+    lock_guard guard(mutex_);
+    return is_stale_ ? 0 : byte_size_;
+}
+
+void TopDocumentsCache::DropIfStale() const {
+    if (is_stale_) {
+        entries_.clear();
+        byte_size_ = 0;
+        is_stale_ = false;
+    }
+}
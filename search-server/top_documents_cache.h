@@ -0,0 +1,37 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// Ranked results of single-word queries, one list per DocumentStatus, valid until the next change of the index.
+// Safe to use from concurrent queries.
+class TopDocumentsCache {
+public:
+    using Entry = std::array<std::vector<Document>, DOCUMENT_STATUS_COUNT>;
+
+    // Nullptr if the term is not cached
+    std::shared_ptr<const Entry> Find(std::string_view term) const;
+
+    void Insert(std::string_view term, std::shared_ptr<const Entry> entry) const;
+
+    // Drops every entry on the next access, so that a change of the index costs nothing more
+    void Invalidate();
+
+    size_t ByteSize() const;
+
+private:
+    mutable std::mutex mutex_;
+    mutable std::map<std::string, std::shared_ptr<const Entry>, std::less<>> entries_;
+    mutable size_t byte_size_ = 0;
+    mutable bool is_stale_ = false;
+
+    // Requires the mutex
+    void DropIfStale() const;
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// LEB128-style unsigned integers: 7 bits per byte, high bit set on every byte but the last
+
+// Bytes of the longest varint, one of 64 bits
+const int MAX_VARINT_BYTES = 10;
+
+template <typename ByteContainer>
+void AppendVarint(ByteContainer& bytes, uint64_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<typename ByteContainer::value_type>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<typename ByteContainer::value_type>(value));
+}
+
+// Decodes a value starting at current and moves current past it, never reading beyond end.
+// Throws std::runtime_error if the value does not end within MAX_VARINT_BYTES bytes.
+template <typename Byte>
+uint64_t ReadVarint(const Byte*& current, const Byte* end) {
+    uint64_t value = 0;
+    for (int shift = 0; current != end; shift += 7) {
+        if (shift == 7 * MAX_VARINT_BYTES) {
+            throw std::runtime_error("Varint is longer than 10 bytes");
+        }
+        const uint8_t byte = static_cast<uint8_t>(*current++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
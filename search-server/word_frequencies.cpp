@@ -0,0 +1,48 @@
+#include "word_frequencies.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+WordFrequencies::WordFrequencies(const vector<ForwardIndexEntry>& entries)
+        : begin_(entries.data())
+        , end_(entries.data() + entries.size())
+{
+}
+
+WordFrequencies::Iterator WordFrequencies::begin() const {
+    return Iterator(begin_);
+}
+
+WordFrequencies::Iterator WordFrequencies::end() const {
+    return Iterator(end_);
+}
+
+size_t WordFrequencies::size() const {
+    return end_ - begin_;
+}
+
+bool WordFrequencies::empty() const {
+    return begin_ == end_;
+}
+
+size_t WordFrequencies::count(string_view word) const {
+    return Find(word) != end_ ? 1 : 0;
+}
+
+double WordFrequencies::at(string_view word) const {
+    const ForwardIndexEntry* entry = Find(word);
+    if (entry == end_) {
+        throw out_of_range("No word "s + string(word) + " in the document"s);
+    }
+    return *entry->freq;
+}
+
+const ForwardIndexEntry* WordFrequencies::Find(string_view word) const {
+    const ForwardIndexEntry* entry = lower_bound(begin_, end_, word, [](const ForwardIndexEntry& lhs, string_view rhs) {
+        return lhs.word < rhs;
+    });
+    return entry != end_ && entry->word == word ? entry : end_;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Word of a document in the forward index. The frequency is stored once, in the inverted index posting.
+struct ForwardIndexEntry {
+    std::string_view word;
+    const double* freq;
+};
+
+// Read-only view of the words of a document with their frequencies, in word order.
+// Valid until the document is removed.
+class WordFrequencies {
+public:
+    // Yields the pairs by value, as the frequencies live in the postings, so it is an input iterator only
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        explicit Iterator(const ForwardIndexEntry* entry)
+                : entry_(entry) {
+        }
+
+        value_type operator*() const {
+            return { entry_->word, *entry_->freq };
+        }
+
+        Iterator& operator++() {
+            ++entry_;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            return Iterator(entry_++);
+        }
+
+        bool operator==(const Iterator& other) const {
+            return entry_ == other.entry_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return entry_ != other.entry_;
+        }
+
+    private:
+        const ForwardIndexEntry* entry_;
+    };
+
+    WordFrequencies() = default;
+
+    explicit WordFrequencies(const std::vector<ForwardIndexEntry>& entries);
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    size_t count(std::string_view word) const;
+
+    // Throws std::out_of_range if the document does not contain the word
+    double at(std::string_view word) const;
+
+private:
+    const ForwardIndexEntry* begin_ = nullptr;
+    const ForwardIndexEntry* end_ = nullptr;
+
+    const ForwardIndexEntry* Find(std::string_view word) const;
+};
@@ -0,0 +1,451 @@
+#include "write_ahead_log.h"
+#include "crc32c.h"
+#include "search_protocol.h"
+#include "varint.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char SEGMENT_PREFIX[] = "wal-";
+const char SEGMENT_SUFFIX[] = ".log";
+const char SNAPSHOT_PREFIX[] = "snapshot-";
+const char SNAPSHOT_SUFFIX[] = ".tsv";
+const char TEMPORARY_SUFFIX[] = ".tmp";
+const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+// A larger size can only be read from a torn header
+const uint32_t MAX_RECORD_SIZE = 64u << 20;
+// Snapshot bytes buffered before a write
+const size_t SNAPSHOT_BUFFER_SIZE = 1 << 20;
+
+string MakeFileName(const string& directory, string_view prefix, uint64_t sequence, string_view suffix) {
+    // Zero-padded, so that the names sort as the sequences do
+    char number[21];
+    snprintf(number, sizeof(number), "%020llu", static_cast<unsigned long long>(sequence));
+    return (filesystem::path(directory) / (string(prefix) + number + string(suffix))).string();
+}
+
+// Files of the directory named prefix<sequence>suffix, by sequence
+vector<pair<uint64_t, string>> ListFiles(const string& directory, string_view prefix, string_view suffix) {
+    vector<pair<uint64_t, string>> files;
+    error_code error;
+    for (const auto& entry : filesystem::directory_iterator(directory, error)) {
+        const string name = entry.path().filename().string();
+        if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0
+                || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+        const string number = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+        if (!all_of(number.begin(), number.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        files.emplace_back(stoull(number), entry.path().string());
+    }
+    sort(files.begin(), files.end());
+    return files;
+}
+
+// Makes the creation, renaming and removal of the files of the directory durable
+void SyncDirectory(const string& directory) {
+    const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw runtime_error("Cannot open "s + directory + ": "s + strerror(errno));
+    }
+    const int result = fsync(fd);
+    close(fd);
+    if (result != 0) {
+        throw runtime_error("Cannot sync "s + directory + ": "s + strerror(errno));
+    }
+}
+
+// Returns false with errno set on failure
+bool WriteAll(int fd, string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    return true;
+}
+
+void DecodeRecord(string_view body, LogRecord& record) {
+    PayloadReader reader(body);
+    record.sequence = reader.ReadVarint();
+    record.type = static_cast<LogRecordType>(reader.ReadByte());
+    record.document_id = static_cast<int>(reader.ReadSignedVarint());
+    record.ratings.clear();
+    record.text = {};
+    switch (record.type) {
+        case LogRecordType::ADD_DOCUMENT:
+            record.status = static_cast<DocumentStatus>(reader.ReadByte());
+            for (size_t rating_count = reader.ReadVarint(); rating_count > 0; --rating_count) {
+                record.ratings.push_back(static_cast<int>(reader.ReadSignedVarint()));
+            }
+            record.text = reader.ReadString();
+            break;
+        case LogRecordType::REMOVE_DOCUMENT:
+            break;
+        default:
+            throw runtime_error("Unknown log record type "s + to_string(static_cast<int>(record.type)));
+    }
+}
+
+// Replays the records of a segment numbered after sequence, advancing it, up to the first torn or corrupt
+// record; returns the size of the records before it
+uint64_t ReplaySegment(const string& path, uint64_t first_sequence, uint64_t& sequence, const function<void(const LogRecord&)>& consumer) {
+    if (first_sequence > sequence) {
+        throw runtime_error("Log records "s + to_string(sequence + 1) + " to "s + to_string(first_sequence) + " are missing"s);
+    }
+    ifstream input(path, ios::binary);
+    if (!input) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    string body;
+    LogRecord record;
+    uint64_t valid_size = 0;
+    while (true) {
+        char header[RECORD_HEADER_SIZE];
+        if (!input.read(header, RECORD_HEADER_SIZE)) {
+            break;
+        }
+        uint32_t size;
+        uint32_t crc;
+        memcpy(&size, header, sizeof(size));
+        memcpy(&crc, header + sizeof(size), sizeof(crc));
+        if (size > MAX_RECORD_SIZE) {
+            break;
+        }
+        body.resize(size);
+        if (!input.read(body.data(), size) || ComputeCrc32c(body) != crc) {
+            break;
+        }
+        DecodeRecord(body, record);
+        valid_size += RECORD_HEADER_SIZE + size;
+        if (record.sequence <= sequence) {
+            continue;
+        }
+        if (record.sequence != sequence + 1) {
+            throw runtime_error("Log records "s + to_string(sequence + 1) + " to "s + to_string(record.sequence - 1) + " are missing"s);
+        }
+        consumer(record);
+        sequence = record.sequence;
+    }
+    return valid_size;
+}
+
+}
+
+optional<SnapshotFile> FindLatestSnapshot(const string& directory) {
+    const auto snapshots = ListFiles(directory, SNAPSHOT_PREFIX, SNAPSHOT_SUFFIX);
+    if (snapshots.empty()) {
+        return nullopt;
+    }
+    return SnapshotFile{ snapshots.back().second, snapshots.back().first };
+}
+
+uint64_t ReplayLog(const string& directory, uint64_t after_sequence, const function<void(const LogRecord&)>& consumer) {
+    uint64_t sequence = after_sequence;
+    for (const auto& [first_sequence, path] : ListFiles(directory, SEGMENT_PREFIX, SEGMENT_SUFFIX)) {
+        const uint64_t valid_size = ReplaySegment(path, first_sequence, sequence, consumer);
+        // Cuts off the torn tail a crash left, so that the segment reads cleanly on the next recovery too
+        if (filesystem::file_size(path) != valid_size) {
+            filesystem::resize_file(path, valid_size);
+        }
+    }
+    return sequence;
+}
+
+uint64_t FindSealedSequence(const string& directory) {
+    const auto segments = ListFiles(directory, SEGMENT_PREFIX, SEGMENT_SUFFIX);
+    return segments.empty() ? 0 : segments.back().first;
+}
+
+uint64_t ReplaySealedLog(const string& directory, uint64_t after_sequence, const function<void(const LogRecord&)>& consumer) {
+    uint64_t sequence = after_sequence;
+    auto segments = ListFiles(directory, SEGMENT_PREFIX, SEGMENT_SUFFIX);
+    if (!segments.empty()) {
+        segments.pop_back();
+    }
+    for (const auto& [first_sequence, path] : segments) {
+        ReplaySegment(path, first_sequence, sequence, consumer);
+    }
+    return sequence;
+}
+
+WriteAheadLog::WriteAheadLog(string directory, uint64_t last_sequence, const WriteAheadLogOptions& options)
+        : directory_(move(directory))
+        , options_(options)
+        , last_sequence_(last_sequence)
+        , durable_sequence_(last_sequence)
+{
+    filesystem::create_directories(directory_);
+    OpenSegment(last_sequence);
+    writer_ = thread([this] {
+        WriteGroups();
+    });
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        lock_guard guard(mutex_);
+        is_stopping_ = true;
+    }
+    records_appended_.notify_one();
+    writer_.join();
+    close(fd_);
+}
+
+uint64_t WriteAheadLog::AppendAddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    PayloadWriter writer;
+    writer.WriteByte(static_cast<uint8_t>(LogRecordType::ADD_DOCUMENT));
+    writer.WriteSignedVarint(document_id);
+    writer.WriteByte(static_cast<uint8_t>(status));
+    writer.WriteVarint(ratings.size());
+    for (const int rating : ratings) {
+        writer.WriteSignedVarint(rating);
+    }
+    writer.WriteString(document);
+    return Append(writer.Release());
+}
+
+uint64_t WriteAheadLog::AppendRemoveDocument(int document_id) {
+    PayloadWriter writer;
+    writer.WriteByte(static_cast<uint8_t>(LogRecordType::REMOVE_DOCUMENT));
+    writer.WriteSignedVarint(document_id);
+    return Append(writer.Release());
+}
+
+uint64_t WriteAheadLog::Append(const string& body_fields) {
+    lock_guard guard(mutex_);
+    const uint64_t sequence = ++last_sequence_;
+    string sequence_bytes;
+    AppendVarint(sequence_bytes, sequence);
+    const uint32_t size = static_cast<uint32_t>(sequence_bytes.size() + body_fields.size());
+    const uint32_t crc = ExtendCrc32c(ComputeCrc32c(sequence_bytes), body_fields);
+
+    const bool was_empty = buffer_.empty();
+    if (was_empty) {
+        first_buffered_time_ = chrono::steady_clock::now();
+    }
+    char header[RECORD_HEADER_SIZE];
+    memcpy(header, &size, sizeof(size));
+    memcpy(header + sizeof(size), &crc, sizeof(crc));
+    buffer_.append(header, RECORD_HEADER_SIZE);
+    buffer_ += sequence_bytes;
+    buffer_ += body_fields;
+    ++buffered_record_count_;
+    // The writer thread only needs to know when a group starts and when it is full
+    if (was_empty || buffer_.size() >= options_.max_group_bytes) {
+        records_appended_.notify_one();
+    }
+    return sequence;
+}
+
+void WriteAheadLog::WaitDurable(uint64_t sequence) {
+    unique_lock lock(mutex_);
+    records_durable_.wait(lock, [this, sequence] {
+        return durable_sequence_ >= sequence || !error_.empty();
+    });
+    if (durable_sequence_ < sequence) {
+        throw runtime_error(error_);
+    }
+}
+
+uint64_t WriteAheadLog::GetLastSequence() const {
+    lock_guard guard(mutex_);
+    return last_sequence_;
+}
+
+uint64_t WriteAheadLog::StartSegment() {
+    unique_lock lock(mutex_);
+    records_durable_.wait(lock, [this] {
+        return durable_sequence_ == last_sequence_ || !error_.empty();
+    });
+    if (!error_.empty()) {
+        throw runtime_error(error_);
+    }
+    // The writer thread is idle until the next append, which waits for the lock
+    close(fd_);
+    fd_ = -1;
+    OpenSegment(last_sequence_);
+    return last_sequence_;
+}
+
+void WriteAheadLog::RemoveFilesBefore(uint64_t sequence) const {
+    for (const auto& [snapshot_sequence, path] : ListFiles(directory_, SNAPSHOT_PREFIX, SNAPSHOT_SUFFIX)) {
+        if (snapshot_sequence < sequence) {
+            filesystem::remove(path);
+        }
+    }
+    const auto segments = ListFiles(directory_, SEGMENT_PREFIX, SEGMENT_SUFFIX);
+    for (size_t i = 0; i + 1 < segments.size(); ++i) {
+        // The records of a segment end where the next one starts
+        if (segments[i + 1].first <= sequence) {
+            filesystem::remove(segments[i].second);
+        }
+    }
+    SyncDirectory(directory_);
+}
+
+const string& WriteAheadLog::GetDirectory() const {
+    return directory_;
+}
+
+void WriteAheadLog::OpenSegment(uint64_t sequence) {
+    const string path = MakeFileName(directory_, SEGMENT_PREFIX, sequence, SEGMENT_SUFFIX);
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw runtime_error("Cannot open "s + path + ": "s + strerror(errno));
+    }
+    SyncDirectory(directory_);
+    segment_sequence_ = sequence;
+    segment_start_time_ = chrono::steady_clock::now();
+}
+
+void WriteAheadLog::SealIfDue() {
+    if (options_.seal_interval.count() == 0 || !error_.empty() || durable_sequence_ == segment_sequence_
+            || chrono::steady_clock::now() < segment_start_time_ + options_.seal_interval) {
+        return;
+    }
+    close(fd_);
+    fd_ = -1;
+    try {
+        OpenSegment(durable_sequence_);
+    } catch (const exception& e) {
+        error_ = e.what();
+        records_durable_.notify_all();
+    }
+}
+
+void WriteAheadLog::WriteGroups() {
+    unique_lock lock(mutex_);
+    const auto has_work = [this] {
+        return !buffer_.empty() || is_stopping_;
+    };
+    while (true) {
+        // A segment holding records is sealed on time even if no more records come
+        if (options_.seal_interval.count() != 0 && durable_sequence_ != segment_sequence_) {
+            records_appended_.wait_until(lock, segment_start_time_ + options_.seal_interval, has_work);
+        } else {
+            records_appended_.wait(lock, has_work);
+        }
+        if (buffer_.empty()) {
+            if (is_stopping_) {
+                return;
+            }
+            SealIfDue();
+            continue;
+        }
+        // More records may join the group until it is full or its first record has waited long enough,
+        // unless the last group shows there is no one else to wait for
+        if (last_group_record_count_ > 1) {
+            records_appended_.wait_until(lock, first_buffered_time_ + options_.group_commit_delay, [this] {
+                return buffer_.size() >= options_.max_group_bytes || is_stopping_;
+            });
+        }
+        WriteGroup(lock);
+        SealIfDue();
+    }
+}
+
+void WriteAheadLog::WriteGroup(unique_lock<mutex>& lock) {
+    group_.swap(buffer_);
+    buffer_.clear();
+    last_group_record_count_ = exchange(buffered_record_count_, 0);
+    const uint64_t group_sequence = last_sequence_;
+    const int fd = fd_;
+    lock.unlock();
+
+    string error;
+    if (!WriteAll(fd, group_)) {
+        error = "Cannot write the log: "s + strerror(errno);
+    } else if (options_.sync && fdatasync(fd) != 0) {
+        error = "Cannot sync the log: "s + strerror(errno);
+    }
+
+    lock.lock();
+    // A failed group may be partly written, so no later record can be acknowledged either
+    if (!error.empty() && error_.empty()) {
+        error_ = move(error);
+    } else if (error_.empty()) {
+        durable_sequence_ = group_sequence;
+    }
+    records_durable_.notify_all();
+}
+
+SnapshotWriter::SnapshotWriter(const string& directory, uint64_t sequence)
+        : directory_(directory)
+        , path_(MakeFileName(directory, SNAPSHOT_PREFIX, sequence, SNAPSHOT_SUFFIX))
+        , temporary_path_(path_ + TEMPORARY_SUFFIX)
+        , fd_(open(temporary_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644))
+{
+    if (fd_ < 0) {
+        throw runtime_error("Cannot create "s + temporary_path_ + ": "s + strerror(errno));
+    }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (fd_ >= 0) {
+        close(fd_);
+        unlink(temporary_path_.c_str());
+    }
+}
+
+void SnapshotWriter::Write(int document_id, DocumentStatus status, const vector<int>& ratings, string_view text) {
+    // A TSV record as the bulk loader reads it; valid document texts have no tabs or line breaks
+    buffer_ += to_string(document_id);
+    buffer_ += '\t';
+    buffer_ += GetStatusName(status);
+    buffer_ += '\t';
+    for (size_t i = 0; i < ratings.size(); ++i) {
+        if (i > 0) {
+            buffer_ += ',';
+        }
+        buffer_ += to_string(ratings[i]);
+    }
+    buffer_ += '\t';
+    buffer_ += text;
+    buffer_ += '\n';
+    if (buffer_.size() >= SNAPSHOT_BUFFER_SIZE) {
+        Flush();
+    }
+}
+
+void SnapshotWriter::Commit() {
+    Flush();
+    if (fsync(fd_) != 0) {
+        throw runtime_error("Cannot sync "s + temporary_path_ + ": "s + strerror(errno));
+    }
+    close(fd_);
+    fd_ = -1;
+    if (rename(temporary_path_.c_str(), path_.c_str()) != 0) {
+        const string error = strerror(errno);
+        unlink(temporary_path_.c_str());
+        throw runtime_error("Cannot rename "s + temporary_path_ + ": "s + error);
+    }
+    SyncDirectory(directory_);
+}
+
+void SnapshotWriter::Flush() {
+    if (!WriteAll(fd_, buffer_)) {
+        throw runtime_error("Cannot write "s + temporary_path_ + ": "s + strerror(errno));
+    }
+    buffer_.clear();
+}
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "bulk_loader.h"
+#include "document.h"
+#include "document_store.h"
+
+// Durable index updates. A directory holds
+//   wal-<sequence>.log       log segments, holding the records numbered after the sequence
+//   snapshot-<sequence>.tsv  all documents once the records up to the sequence are applied, as a TSV corpus
+// Only the newest segment is appended to; the older ones are sealed and never change, so that other processes
+// may follow the directory, see replica_index.h.
+// A log record is framed as
+//   u32 body size | u32 CRC-32C of the body | body
+// with the body made of the varint sequence number, a u8 LogRecordType and the varint fields of the update.
+
+enum class LogRecordType : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+};
+
+// The text views a buffer valid only while the record is being replayed
+struct LogRecord {
+    uint64_t sequence = 0;
+    LogRecordType type = LogRecordType::ADD_DOCUMENT;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+struct WriteAheadLogOptions {
+    // Longest a record waits for more records to share its write and fsync, the latency bound of group commit.
+    // Only records of concurrent writers wait, a group is written at once after a group of a single record.
+    std::chrono::microseconds group_commit_delay{500};
+    // A group is written without waiting any longer once its records take this many bytes
+    size_t max_group_bytes = 1 << 20;
+    // Whether a group is fdatasync'ed before its records are acknowledged; without it they only reach the page cache
+    bool sync = true;
+    // A segment holding records is sealed this long after it was started, which bounds how far replicas following
+    // the directory lag behind; zero seals segments only at checkpoints and on DurableIndex::SealLog
+    std::chrono::milliseconds seal_interval{0};
+};
+
+struct SnapshotFile {
+    std::string path;
+    uint64_t sequence = 0;
+};
+
+// The snapshot of the directory with the highest sequence, if any
+std::optional<SnapshotFile> FindLatestSnapshot(const std::string& directory);
+
+// Hands consumer the records of the log segments of the directory numbered after the sequence, in order, and
+// returns the sequence of the last one (or the given sequence if there are none). A segment ends at its first
+// torn or corrupt record, which is cut off the file. Throws std::runtime_error if records are missing in between.
+uint64_t ReplayLog(const std::string& directory, uint64_t after_sequence, const std::function<void(const LogRecord&)>& consumer);
+
+// Sequence of the last record of the sealed segments of the directory, the first sequence of the newest segment
+uint64_t FindSealedSequence(const std::string& directory);
+
+// As ReplayLog, but over the sealed segments only and without modifying the directory, so that a process can
+// follow the log another one is writing
+uint64_t ReplaySealedLog(const std::string& directory, uint64_t after_sequence, const std::function<void(const LogRecord&)>& consumer);
+
+// Appends records to a new log segment of a directory. Appending only buffers a record; a background thread
+// writes the buffered records of all writers at once and syncs them with a single fdatasync, after which
+// WaitDurable returns for all of them. Safe to use from concurrent writers.
+class WriteAheadLog {
+public:
+    // Starts a segment after last_sequence, the sequence recovery replayed the directory up to
+    WriteAheadLog(std::string directory, uint64_t last_sequence, const WriteAheadLogOptions& options = {});
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Writes the buffered records
+    ~WriteAheadLog();
+
+    // These return the sequence number of the record
+    uint64_t AppendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    uint64_t AppendRemoveDocument(int document_id);
+
+    // Blocks until the record is durable; throws std::runtime_error if writing the log failed
+    void WaitDurable(uint64_t sequence);
+
+    uint64_t GetLastSequence() const;
+
+    // Makes every record durable and continues in a new segment, returning the last sequence of the previous ones
+    uint64_t StartSegment();
+
+    // Deletes the snapshots before the one of sequence and the segments holding no records after it
+    void RemoveFilesBefore(uint64_t sequence) const;
+
+    const std::string& GetDirectory() const;
+
+private:
+    const std::string directory_;
+    const WriteAheadLogOptions options_;
+    mutable std::mutex mutex_;
+    // Signals the writer thread about new records, and waiting writers about durable ones
+    std::condition_variable records_appended_;
+    std::condition_variable records_durable_;
+    std::string buffer_;
+    // The group being written, its memory is reused by the next one
+    std::string group_;
+    std::chrono::steady_clock::time_point first_buffered_time_;
+    size_t buffered_record_count_ = 0;
+    size_t last_group_record_count_ = 0;
+    // Sequence the current segment starts after, and when it was started
+    uint64_t segment_sequence_ = 0;
+    std::chrono::steady_clock::time_point segment_start_time_;
+    uint64_t last_sequence_;
+    uint64_t durable_sequence_;
+    int fd_ = -1;
+    std::string error_;
+    bool is_stopping_ = false;
+    std::thread writer_;
+
+    uint64_t Append(const std::string& body_fields);
+
+    void OpenSegment(uint64_t sequence);
+
+    // Continues in a new segment if the current one holds records and seal_interval has passed
+    void SealIfDue();
+
+    void WriteGroups();
+
+    // Writes and syncs the buffered records, unlocking the mutex meanwhile
+    void WriteGroup(std::unique_lock<std::mutex>& lock);
+};
+
+// Writes a snapshot to a temporary file, which Commit syncs and renames into place
+class SnapshotWriter {
+public:
+    SnapshotWriter(const std::string& directory, uint64_t sequence);
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Removes the temporary file unless the snapshot was committed
+    ~SnapshotWriter();
+
+    void Write(int document_id, DocumentStatus status, const std::vector<int>& ratings, std::string_view text);
+
+    void Commit();
+
+private:
+    const std::string directory_;
+    const std::string path_;
+    const std::string temporary_path_;
+    std::string buffer_;
+    int fd_;
+
+    void Flush();
+};
+
+// Writes all documents of the index to the snapshot of the sequence, replacing it atomically.
+// Requires the stored documents of the index, see IndexOptions::store_documents.
+template <typename Index>
+void WriteSnapshot(const Index& index, const std::string& directory, uint64_t sequence) {
+    // Documents are read a batch at a time, so the snapshot needs memory for a batch only
+    const size_t BATCH_SIZE = 1024;
+    SnapshotWriter writer(directory, sequence);
+    std::vector<int> document_ids;
+    for (auto it = index.begin(); it != index.end();) {
+        document_ids.clear();
+        for (; it != index.end() && document_ids.size() < BATCH_SIZE; ++it) {
+            document_ids.push_back(*it);
+        }
+        for (const StoredDocument& document : index.GetStoredDocuments(document_ids)) {
+            writer.Write(document.id, index.GetDocumentStatus(document.id), document.ratings, document.text);
+        }
+    }
+    writer.Commit();
+}
+
+template <typename Index>
+void ApplyLogRecord(Index& index, const LogRecord& record) {
+    if (record.type == LogRecordType::ADD_DOCUMENT) {
+        index.AddDocument(record.document_id, record.text, record.status, record.ratings);
+    } else {
+        index.RemoveDocument(record.document_id);
+    }
+}
+
+// Loads the latest snapshot of the directory into an empty index and replays the log after it,
+// returns the sequence of the last record replayed
+template <typename Index>
+uint64_t RecoverIndex(Index& index, const std::string& directory) {
+    uint64_t sequence = 0;
+    if (const auto snapshot = FindLatestSnapshot(directory)) {
+        LoadCorpus(index, snapshot->path);
+        sequence = snapshot->sequence;
+    }
+    return ReplayLog(directory, sequence, [&index](const LogRecord& record) {
+        ApplyLogRecord(index, record);
+    });
+}
+
+// An index whose updates are logged before they are acknowledged. Writers apply an update to the index and
+// append its record under a lock, then wait for the group commit without it, so that concurrent writers share
+// fsyncs. Readers of the index are not synchronized with writers by this class.
+// Once writing the log fails no later record can become durable, so the index fails into a read-only state:
+// the update that saw the failure throws its std::runtime_error, and every later update, seal or checkpoint throws
+// std::runtime_error without touching the index. Updates are not rolled back, so the index may still show the
+// ones that were applied but never acknowledged; recovering an index from the directory drops them.
+template <typename Index>
+class DurableIndex {
+public:
+    // Recovers the empty index from the directory, see RecoverIndex
+    DurableIndex(Index& index, const std::string& directory, const WriteAheadLogOptions& options = {})
+            : index_(index)
+            , log_(directory, RecoverIndex(index, directory), options) {
+    }
+
+    // An update the index rejects is not logged
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+        std::unique_lock lock(mutex_);
+        CheckNotFailed();
+        index_.AddDocument(document_id, document, status, ratings);
+        LogUpdate(lock, [&] {
+            return log_.AppendAddDocument(document_id, document, status, ratings);
+        });
+    }
+
+    void RemoveDocument(int document_id) {
+        std::unique_lock lock(mutex_);
+        CheckNotFailed();
+        index_.RemoveDocument(document_id);
+        LogUpdate(lock, [&] {
+            return log_.AppendRemoveDocument(document_id);
+        });
+    }
+
+    // Seals the current log segment, so that replicas following the directory apply the updates logged so far.
+    // Returns the sequence of the last of them.
+    uint64_t SealLog() {
+        std::lock_guard guard(mutex_);
+        CheckNotFailed();
+        return log_.StartSegment();
+    }
+
+    // Snapshots the index and drops the log before it, so recovery replays only the updates after the checkpoint.
+    // Writers wait while the snapshot is written.
+    void Checkpoint() {
+        std::lock_guard guard(mutex_);
+        CheckNotFailed();
+        const uint64_t sequence = log_.StartSegment();
+        WriteSnapshot(index_, log_.GetDirectory(), sequence);
+        log_.RemoveFilesBefore(sequence);
+    }
+
+    const Index& GetIndex() const {
+        return index_;
+    }
+
+    // Whether writing the log failed, which leaves the index read-only
+    bool IsFailed() const {
+        return is_failed_;
+    }
+
+private:
+    Index& index_;
+    std::mutex mutex_;
+    WriteAheadLog log_;
+    std::atomic<bool> is_failed_ = false;
+
+    void CheckNotFailed() const {
+        if (is_failed_) {
+            throw std::runtime_error("Writing the log failed, the index is read-only");
+        }
+    }
+
+    // Appends the record of the update just applied and waits for it to be durable without the lock
+    template <typename Append>
+    void LogUpdate(std::unique_lock<std::mutex>& lock, Append append) {
+        try {
+            const uint64_t sequence = append();
+            lock.unlock();
+            log_.WaitDurable(sequence);
+        } catch (...) {
+            is_failed_ = true;
+            throw;
+        }
+    }
+};